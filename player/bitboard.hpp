@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "common.h"
+
+static_assert(MAX_MAP_SIZE <= 64, "A map column must fit in a single 64 bit word");
+
+// Boolean map with one 64 bit word per column.
+// Bit y of bits[x] is set if tile (x,y) is set.
+// Bits outside the current map (see w and h) are always kept cleared.
+// A board for the other planet (e.g. the Mars terrain while we are on Earth)
+// does not fit w and h, so only test and set may be used on it.
+struct Bitboard {
+    uint64_t bits[MAX_MAP_SIZE];
+
+    Bitboard() {
+        clear();
+    }
+
+    // Mask with bits [y0, y1] set, clamped to the map
+    static uint64_t rangeMask(int y0, int y1) {
+        y0 = std::max(y0, 0);
+        y1 = std::min(y1, h - 1);
+        if (y0 > y1) return 0;
+        uint64_t upper = y1 >= 63 ? ~0ULL : (1ULL << (y1 + 1)) - 1;
+        return upper & ~((1ULL << y0) - 1);
+    }
+
+    static uint64_t columnMask() {
+        return rangeMask(0, h - 1);
+    }
+
+    void clear() {
+        std::fill(bits, bits + MAX_MAP_SIZE, 0ULL);
+    }
+
+    bool test(int x, int y) const {
+        return (bits[x] >> y) & 1;
+    }
+
+    void set(int x, int y) {
+        bits[x] |= 1ULL << y;
+    }
+
+    void reset(int x, int y) {
+        bits[x] &= ~(1ULL << y);
+    }
+
+    void set(int x, int y, bool value) {
+        if (value) set(x, y);
+        else reset(x, y);
+    }
+
+    bool any() const {
+        for (int x = 0; x < w; x++) {
+            if (bits[x]) return true;
+        }
+        return false;
+    }
+
+    int popcount() const {
+        int count = 0;
+        for (int x = 0; x < w; x++) {
+            count += __builtin_popcountll(bits[x]);
+        }
+        return count;
+    }
+
+    // Number of set tiles in the rectangle [x0,x1] x [y0,y1], clamped to the map
+    int popcount(int x0, int y0, int x1, int y1) const {
+        uint64_t mask = rangeMask(y0, y1);
+        int count = 0;
+        for (int x = std::max(x0, 0); x <= std::min(x1, w - 1); x++) {
+            count += __builtin_popcountll(bits[x] & mask);
+        }
+        return count;
+    }
+
+    // True if any tile within the given squared distance from (x,y) is set
+    bool anyInDisc(int x, int y, int squaredRadius) const {
+        int r;
+        for (r = 0; (r+1)*(r+1) <= squaredRadius; ++r);
+        int k = 0;
+        for (int dx = r; dx >= 0; --dx) {
+            // Half height of the disc in the columns dx tiles away from the center
+            while (dx*dx + (k+1)*(k+1) <= squaredRadius) ++k;
+            uint64_t mask = rangeMask(y - k, y + k);
+            if ((x - dx >= 0 && (bits[x - dx] & mask)) || (x + dx < w && (bits[x + dx] & mask))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Calls f(x, y) for every set tile, in column order
+    template<class F>
+    void forEach(F f) const {
+        for (int x = 0; x < w; x++) {
+            uint64_t column = bits[x];
+            while (column != 0) {
+                int y = __builtin_ctzll(column);
+                column &= column - 1;
+                f(x, y);
+            }
+        }
+    }
+
+    Bitboard& operator|=(const Bitboard& other) {
+        for (int x = 0; x < MAX_MAP_SIZE; x++) bits[x] |= other.bits[x];
+        return *this;
+    }
+
+    Bitboard& operator&=(const Bitboard& other) {
+        for (int x = 0; x < MAX_MAP_SIZE; x++) bits[x] &= other.bits[x];
+        return *this;
+    }
+
+    Bitboard operator|(const Bitboard& other) const {
+        Bitboard result = *this;
+        return result |= other;
+    }
+
+    Bitboard operator&(const Bitboard& other) const {
+        Bitboard result = *this;
+        return result &= other;
+    }
+
+    // Complement within the map
+    Bitboard operator~() const {
+        Bitboard result;
+        uint64_t mask = columnMask();
+        for (int x = 0; x < w; x++) result.bits[x] = ~bits[x] & mask;
+        return result;
+    }
+};
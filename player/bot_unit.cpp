@@ -1,6 +1,11 @@
 #include "bot_unit.h"
 #include "maps.h"
 #include "influence.h"
+#include "vision.h"
+#include "gamecache.h"
+#include "staticmaps.h"
+#include "unitinfo.h"
+#include "parallel.h"
 
 using namespace bc;
 using namespace std;
@@ -48,7 +53,7 @@ void addRocketTarget(const Unit& unit, PathfindingMap& targetMap) {
 
     if (gc.get_round() > 650) {
         if (planet == Earth) {
-            targetMap += rocketAttractionMap;
+            targetMap += rocketAttractionLayer.get();
         }
     }
     else {
@@ -66,7 +71,8 @@ void addRocketTarget(const Unit& unit, PathfindingMap& targetMap) {
     }
 }
 
-MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
+bool BotUnit::preparePathfinding(MapLocation from, bool allowStructures, PathfindingMap& targetMap, PathfindingMap& costMap, MapLocation& next) {
+    next = from;
     bool canMove = false;
     int x = from.get_x();
     int y = from.get_y();
@@ -82,22 +88,22 @@ MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
         }
     }
     if (!canMove) {
-        return from;
+        return false;
     }
     if (isRocketFodder) {
         if (y > 0 && passableMap.weights[x][y-1] < 1000) {
-            return from.add(South);
+            next = from.add(South);
         }
-        if (x > 0) {
-            return from.add(West);
+        else if (x > 0) {
+            next = from.add(West);
         }
-        return from;
+        return false;
     }
     double start = millis();
-    auto targetMap = getTargetMap();
+    targetMap = getTargetMap();
     targetMapComputationTime += millis() - start;
     double start2 = millis();
-    auto costMap = getCostMap();
+    costMap = getCostMap();
     costMapComputationTime += millis() - start2;
     if (allowStructures) {
         costMap.weights[x][y] = 1;
@@ -110,7 +116,7 @@ MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
                 int ny = y + dy;
                 if (nx >= 0 && ny >= 0 && nx < (int)costMap.weights.size() && ny < (int)costMap.weights[nx].size()) {
                     MapLocation location(gc.get_planet(), nx, ny);
-                    if (gc.can_sense_location(location) && gc.has_unit_at_location(location)) {
+                    if (canSenseLocation.test(nx, ny) && gc.has_unit_at_location(location)) {
                         costMap.weights[nx][ny] = numeric_limits<double>::infinity();
                     }
                 }
@@ -118,7 +124,17 @@ MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
         }
     }
     mapComputationTime += millis() - start;
-    start = millis();
+    return true;
+}
+
+MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
+    PathfindingMap targetMap;
+    PathfindingMap costMap;
+    MapLocation next;
+    if (!preparePathfinding(from, allowStructures, targetMap, costMap, next)) {
+        return next;
+    }
+    double start = millis();
     Pathfinder pathfinder;
     auto nextLocation = pathfinder.getNextLocation(from, targetMap, costMap);
     pathfindingScore = pathfinder.bestScore;
@@ -127,8 +143,66 @@ MapLocation BotUnit::getNextLocation(MapLocation from, bool allowStructures) {
     return nextLocation;
 }
 
+int movePlansUsed;
+int movePlansReplanned;
+
 MapLocation BotUnit::getNextLocation() {
-    return getNextLocation(unit.get_location().get_map_location(), true);
+    auto from = unit.get_location().get_map_location();
+    if (movePlan.valid) {
+        movePlan.valid = false;
+        auto& next = movePlan.next;
+        if (movePlan.from.x == from.get_x() && movePlan.from.y == from.get_y() && passableMap.weights[next.x][next.y] == movePlan.nextTileWeight) {
+            movePlansUsed++;
+            pathfindingScore = movePlan.score;
+            return MapLocation(planet, next.x, next.y);
+        }
+        movePlansReplanned++;
+    }
+    return getNextLocation(from, true);
+}
+
+void planMoves(const vector<BotUnit*>& units, const vector<Position>& from) {
+    for (size_t i = 0; i < units.size(); i++) {
+        auto u = units[i];
+        auto& plan = u->movePlan;
+        MapLocation next;
+        plan.needsPathfinding = u->preparePathfinding(MapLocation(planet, from[i].x, from[i].y), true, plan.targetMap, plan.costMap, next);
+        plan.from = from[i];
+        plan.next = Position(next.get_x(), next.get_y());
+        plan.score = u->pathfindingScore;
+    }
+
+    double start = millis();
+    // Units that were not planned before the deadline do not move this turn
+    vector<char> planned(units.size(), 1);
+    threadPool.parallelFor(units.size(), [&](int i) {
+        auto& plan = units[i]->movePlan;
+        if (plan.needsPathfinding) {
+            if (turnDeadlinePassed.load(memory_order_relaxed)) {
+                planned[i] = false;
+                return;
+            }
+            Pathfinder pathfinder;
+            auto path = pathfinder.getPath(plan.from, plan.targetMap, plan.costMap);
+            plan.next = path[path.size() > 1 ? 1 : 0];
+            plan.score = pathfinder.bestScore;
+            // The maps are not needed anymore
+            plan.targetMap = PathfindingMap();
+            plan.costMap = PathfindingMap();
+        }
+    });
+    pathfindingTime += millis() - start;
+
+    for (size_t i = 0; i < units.size(); i++) {
+        auto& plan = units[i]->movePlan;
+        if (!planned[i]) {
+            plan.targetMap = PathfindingMap();
+            plan.costMap = PathfindingMap();
+            continue;
+        }
+        plan.nextTileWeight = passableMap.weights[plan.next.x][plan.next.y];
+        plan.valid = true;
+    }
 }
 
 void BotUnit::moveToLocation(MapLocation nextLocation) {
@@ -137,11 +211,11 @@ void BotUnit::moveToLocation(MapLocation nextLocation) {
         auto d = unitMapLocation.direction_to(nextLocation);
         if (gc.is_move_ready(id)) {
             if (gc.can_move(id, d)) {
-                passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1;
+                setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1);
                 gc.move_robot(id,d);
-                invalidate_unit(id);
+                onMove(id);
                 unitMapLocation = unit.get_location().get_map_location();
-                passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1000;
+                setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1000);
             }
             else if(gc.has_unit_at_location(nextLocation)) {
                 auto u = gc.sense_unit_at_location(nextLocation);
@@ -150,10 +224,9 @@ void BotUnit::moveToLocation(MapLocation nextLocation) {
                         if (u.get_unit_type() == Rocket && unit.get_unit_type() == Worker) {
                             ++launchedWorkerCount;
                         }
-                        passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1;
+                        setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1);
                         gc.load(u.get_id(), unit.get_id());
-                        invalidate_unit(u.get_id());
-                        invalidate_unit(unit.get_id());
+                        onLoad(u.get_id(), unit.get_id());
                     }
                 }
             }
@@ -167,31 +240,14 @@ bool BotUnit::unloadFrontUnit() {
     Direction dir = unit.get_location().get_map_location().direction_to(nextLocation);
     if (gc.can_unload(id, dir)){
         gc.unload(id, dir);
-        invalidate_unit(u->unit.get_id());
-        invalidate_unit(id);
+        onUnload(id, u->unit.get_id());
         return true;
     }
     return false;
 }
 
 bool exists_enemy_in_range(int x, int y, int attackRange) {
-    int dis;
-    for (dis = 1; (dis+1)*(dis+1) <= attackRange; ++dis);
-    for (int dx = -dis; dx <= dis; ++dx) {
-        for (int dy = -dis; dy <= dis; ++dy) {
-            int dis2 = dx*dx + dy*dy;
-            if (dis2 > attackRange)
-                continue;
-            int nx = x + dx;
-            int ny = y + dy;
-            if (nx < 0 || ny < 0 || nx >= w || ny >= h)
-                continue;
-            if (enemyExactPositionMap.weights[nx][ny] > 0) {
-                return true;
-            }
-        }
-    }
-    return false;
+    return enemyExactPositions.anyInDisc(x, y, attackRange);
 }
 
 void mage_attack(const Unit& unit) {
@@ -207,10 +263,9 @@ void mage_attack(const Unit& unit) {
         return;
     }
 
-    // Calls on the controller take unit IDs for ownership reasons.
-    const auto nearby = gc.sense_nearby_units(locus, unit.get_attack_range() + 20);
+    const auto nearby = senseNearbyUnits(locus, unit.get_attack_range() + 20);
 
-    const Unit* best_unit = nullptr;
+    const UnitInfo* best_unit = nullptr;
     double best_unit_score = 0;
 
     auto low_health = unit.get_health() / (float)unit.get_max_health() < 0.8f;
@@ -227,11 +282,10 @@ void mage_attack(const Unit& unit) {
             value += 1;
         if (place.get_team() == unit.get_team()) value = -1.5 * value;
 
-        auto location = place.get_location().get_map_location();
         for (int dx = -1; dx <= 1; dx++) {
             for (int dy = -1; dy <= 1; dy++) {
-                int x = location.get_x() + dx;
-                int y = location.get_y() + dy;
+                int x = place.get_x() + dx;
+                int y = place.get_y() + dy;
                 if (x >= 0 && y >= 0 && x < w && y < h) {
                     hitScore[x][y] += value;
                 }
@@ -243,8 +297,7 @@ void mage_attack(const Unit& unit) {
         if (place.get_health() <= 0) continue;
         if (!gc.can_attack(unit.get_id(), place.get_id())) continue;
 
-        auto location = place.get_location().get_map_location();
-        double score = hitScore[location.get_x()][location.get_y()];
+        double score = hitScore[place.get_x()][place.get_y()];
         if (score > best_unit_score) {
             best_unit_score = score;
             best_unit = &place;
@@ -253,8 +306,9 @@ void mage_attack(const Unit& unit) {
 
     if (best_unit != nullptr) {
         //Attacking 'em enemies
+        const auto targetLocation = best_unit->get_map_location();
         gc.attack(unit.get_id(), best_unit->get_id());
-        invalidate_units();
+        onAttack(unit.get_id(), targetLocation);
 #ifndef NDEBUG
         cout << "Mage attack with score " << best_unit_score << endl;
 #endif
@@ -281,10 +335,9 @@ void attack_all_in_range(const Unit& unit) {
     }
     double start = millis();
 
-    // Calls on the controller take unit IDs for ownership reasons.
-    const auto nearby = gc.sense_nearby_units(locus, attackRange);
+    const auto nearby = senseNearbyUnits(locus, attackRange);
 
-    const Unit* best_unit = nullptr;
+    const UnitInfo* best_unit = nullptr;
     //float totalWeight = 0;
 
     auto low_health = unit.get_health() / (float)unit.get_max_health() < 0.8f;
@@ -329,8 +382,9 @@ void attack_all_in_range(const Unit& unit) {
     if (best_unit != nullptr) {
         attackSuccessful = 1;
         //Attacking 'em enemies
+        const auto targetLocation = best_unit->get_map_location();
         gc.attack(id, best_unit->get_id());
-        invalidate_unit(id);
+        onAttack(id, targetLocation);
         turnsSinceLastFight = 0;
     }
 
@@ -429,12 +483,8 @@ PathfindingMap BotUnit::defaultMilitaryTargetMap() {
         }
 
         if (planet == Earth) {
-            auto&& initial_units = gc.get_starting_planet((Planet)0).get_initial_units();
-            for (auto& enemy : initial_units) {
-                if (enemy.get_team() == enemyTeam && enemy.get_location().is_on_map()) {
-                    auto pos = enemy.get_location().get_map_location();
-                    targetMap.weights[pos.get_x()][pos.get_y()] = max(targetMap.weights[pos.get_x()][pos.get_y()], 0.01);
-                }
+            for (auto& pos : initialEnemyPositions) {
+                targetMap.weights[pos.first][pos.second] = max(targetMap.weights[pos.first][pos.second], 0.01);
             }
         }
 
@@ -468,7 +518,7 @@ PathfindingMap BotUnit::defaultMilitaryTargetMap() {
         targetMap /= stuckUnitMap + 1.0;
 
         if (unit.get_unit_type() == Mage) {
-            targetMap /= enemyKnightNearbyMap + mageNearbyFuzzyMap + 0.1;
+            targetMap /= enemyKnightNearbyLayer.get() + mageNearbyFuzzyLayer.get() + 0.1;
         }
 
         reusableMaps[reuseObject] = targetMap;
@@ -499,12 +549,12 @@ PathfindingMap BotUnit::defaultMilitaryCostMap () {
             return costMap;
         }
         else if (unit.get_unit_type() == Ranger){
-            auto costMap = (passableMap + enemyInfluenceMap * 2.0) / (nearbyFriendMap + 1.0) + structureProximityMap * 0.1 + rocketHazardMap * 10.0 + enemyKnightNearbyMap;
+            auto costMap = (passableMap + enemyInfluenceMap * 2.0) / (nearbyFriendMap + 1.0) + structureProximityMap * 0.1 + rocketHazardMap * 10.0 + enemyKnightNearbyLayer.get();
             reusableMaps[reuseObject] = costMap;
             return costMap;
         }
         else{
-            auto costMap = (passableMap + enemyInfluenceMap * 0.5) / (nearbyFriendMap * 0.3 + 1.0) + structureProximityMap * 0.1 + rocketHazardMap * 10.0 + enemyKnightNearbyMap;
+            auto costMap = (passableMap + enemyInfluenceMap * 0.5) / (nearbyFriendMap * 0.3 + 1.0) + structureProximityMap * 0.1 + rocketHazardMap * 10.0 + enemyKnightNearbyLayer.get();
             reusableMaps[reuseObject] = costMap;
             return costMap;
         }
@@ -544,7 +594,7 @@ void BotUnit::default_military_behaviour() {
         attack_all_in_range(unit);
     }
 
-    if (veryLowTimeRemaining)
+    if (veryLowTimeRemaining || turnPreempted("movement"))
         return;
 
     if (gc.is_move_ready(unit.get_id())) {
@@ -5,6 +5,20 @@
 
 extern double averageAttackerSuccessRate;
 
+// Move that was computed before the unit's tick, see planMoves
+struct MovePlan {
+    bool valid = false;
+    bool needsPathfinding = false;
+    Position from;
+    Position next;
+    double score = 0;
+    // passableMap weight of the next tile when the plan was made.
+    // If it has changed when the plan is used, another unit has moved there.
+    double nextTileWeight = 0;
+    PathfindingMap targetMap;
+    PathfindingMap costMap;
+};
+
 struct BotUnit {
     bc::Unit unit;
     const unsigned id;
@@ -12,12 +26,17 @@ struct BotUnit {
     bool hasDoneTick;
     bool isRocketFodder;
     bool hasHarvested;
+    MovePlan movePlan;
     BotUnit(const bc::Unit& unit) : unit(unit.clone()), id(unit.get_id()), hasDoneTick(false), isRocketFodder(false) {}
     virtual ~BotUnit() {}
     virtual void tick();
     virtual PathfindingMap getTargetMap();
     virtual PathfindingMap getCostMap();
 
+    // Computes the target and cost maps for moving from the given location.
+    // Returns false if no pathfinding is needed, next is then set to where the unit should go.
+    bool preparePathfinding(bc::MapLocation from, bool allowStructures, PathfindingMap& targetMap, PathfindingMap& costMap, bc::MapLocation& next);
+
     bc::MapLocation getNextLocation(bc::MapLocation from, bool allowStructures);
 
     bc::MapLocation getNextLocation();
@@ -33,6 +52,15 @@ struct BotUnit {
     void default_military_behaviour();
 };
 
+// Plans the next move of each unit.
+// The maps are computed serially, the pathfinding runs in parallel on the thread pool.
+// The plans are used by getNextLocation when the units tick, unless another unit has moved into the way.
+// from holds the current position of each unit.
+void planMoves(const std::vector<BotUnit*>& units, const std::vector<Position>& from);
+
+extern int movePlansUsed;
+extern int movePlansReplanned;
+
 void addRocketTarget(const Unit& unit, PathfindingMap& targetMap);
 
 // Relative values of different unit types when at "low" (not full) health
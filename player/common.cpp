@@ -1,5 +1,8 @@
 #include "common.h"
 #include "bot_unit.h"
+#include "vision.h"
+#include "maps.h"
+#include "unitinfo.h"
 
 #include <sstream>
 #include <cstring>
@@ -25,11 +28,12 @@ double costMapComputationTime;
 double attackComputationTime;;
 double unitInvalidationTime;
 double matchWorkersTime;
-double hungarianTime;
+double assignmentTime;
 double matchWorkersDijkstraTime;
 double matchWorkersDijkstraTime2;
-vector<vector<bool> > canSenseLocation;
 map<unsigned int, BotUnit*> unitMap;
+deque<unsigned int> tickQueue;
+bool unitsCreated;
 
 Team ourTeam;
 Team enemyTeam;
@@ -63,36 +67,168 @@ void invalidate_unit(unsigned int id) {
         auto botunit = unitMap[id];
         if (botunit != nullptr) {
             auto& unit = botunit->unit;
+            removeVision(unit);
             if (unit.get_location().is_on_map()) {
                 const auto location = unit.get_location().get_map_location();
                 Unit* u = unitAtLocation[location.get_x()][location.get_y()];
-                if (u == nullptr || u->get_id() == unit.get_id())
+                if (u == nullptr || u->get_id() == unit.get_id()) {
                     unitAtLocation[location.get_x()][location.get_y()] = nullptr;
+                    unitOccupancy.reset(location.get_x(), location.get_y());
+                }
             }
         }
     }
     if (gc.has_unit(id)) {
         unitMap[id]->unit = gc.get_unit(id);
         auto& unit = unitMap[id]->unit;
+        addVision(unit);
+        updateUnitInfo(unit);
         if (unit.get_location().is_on_map()) {
             const auto location = unit.get_location().get_map_location();
             unitAtLocation[location.get_x()][location.get_y()] = &unit;
+            unitOccupancy.set(location.get_x(), location.get_y());
         }
     } else {
         unitMap[id] = nullptr;
+        removeUnitInfo(id);
         // Unit has suddenly disappeared, oh noes!
         // Maybe it went into space or something
     }
     unitInvalidationTime += millis() - t0;
 }
 
-/** Call if our units may have been changed in some way, e.g damaged by Mage splash damage and killed */
+/** Call if our units may have been changed in some way that we cannot predict.
+ * Prefer the on* functions below, they only re-sync the units that the action can have touched.
+ * (The snapshots are engine owned bc::Unit objects without setters, so re-syncing is the only way to update them.)
+ */
 void invalidate_units() {
     for (auto& unit : ourUnits) {
         invalidate_unit(unit.get_id());
     }
 }
 
+// Re-sync all units on the given tile and the 8 tiles around it
+static void invalidate_units_around(const MapLocation& location) {
+    int x = location.get_x();
+    int y = location.get_y();
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            int nx = x + dx;
+            int ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                continue;
+            resyncEnemyUnitInfoAt(nx, ny);
+            Unit* u = unitAtLocation[nx][ny];
+            if (u != nullptr && unitMap[u->get_id()] != nullptr) {
+                invalidate_unit(u->get_id());
+            }
+        }
+    }
+}
+
+void onMove(unsigned int robotId) {
+    invalidate_unit(robotId);
+}
+
+void onBlink(unsigned int mageId) {
+    invalidate_unit(mageId);
+}
+
+void onAttack(unsigned int attackerId, const MapLocation& targetLocation) {
+    auto botunit = unitMap[attackerId];
+    if (botunit != nullptr && botunit->unit.get_unit_type() == Mage) {
+        // Splash damage hits everything adjacent to the target, including our own units.
+        // This also covers the attacker if it is standing next to the target.
+        invalidate_units_around(targetLocation);
+    } else {
+        resyncEnemyUnitInfoAt(targetLocation.get_x(), targetLocation.get_y());
+    }
+    invalidate_unit(attackerId);
+}
+
+void onHeal(unsigned int healerId, unsigned int targetId) {
+    invalidate_unit(targetId);
+    invalidate_unit(healerId);
+}
+
+void onOvercharge(unsigned int healerId, unsigned int targetId) {
+    invalidate_unit(targetId);
+    invalidate_unit(healerId);
+}
+
+void onLoad(unsigned int structureId, unsigned int robotId) {
+    invalidate_unit(structureId);
+    invalidate_unit(robotId);
+}
+
+void onUnload(unsigned int structureId, unsigned int robotId) {
+    invalidate_unit(robotId);
+    invalidate_unit(structureId);
+    tickQueue.push_back(robotId);
+}
+
+void onBuild(unsigned int workerId, unsigned int structureId) {
+    invalidate_unit(workerId);
+    // A blueprint placed this turn does not have a bot unit yet, findUnits will pick it up
+    if (unitMap.find(structureId) == unitMap.end() || unitMap[structureId] == nullptr) {
+        return;
+    }
+    invalidate_unit(structureId);
+    // An unfinished rocket returns from its tick without setting hasDoneTick, so once it is finished it can still
+    // load and launch this turn. Factories always finish their tick, there is nothing to requeue for them.
+    auto botunit = unitMap[structureId];
+    if (botunit->unit.get_unit_type() == Rocket && botunit->unit.structure_is_built()) {
+        tickQueue.push_back(structureId);
+    }
+}
+
+void onReplicate(unsigned int workerId) {
+    invalidate_unit(workerId);
+    unitsCreated = true;
+}
+
+void onBlueprint(unsigned int workerId) {
+    invalidate_unit(workerId);
+    unitsCreated = true;
+}
+
+void onRocketLaunch(unsigned int rocketId, const vector<unsigned>& garrison, const MapLocation& location) {
+    for (auto id : garrison) {
+        invalidate_unit(id);
+    }
+    // The launch blast damages all adjacent units
+    invalidate_units_around(location);
+    invalidate_unit(rocketId);
+}
+
+#ifndef NDEBUG
+/** Compares our local unit snapshots with the engine to catch actions with effects that we did not model */
+void verifyUnitSnapshots() {
+    for (auto& unit : ourUnits) {
+        auto id = unit.get_id();
+        if (!unitMap.count(id) || unitMap[id] == nullptr) {
+            continue;
+        }
+        if (!gc.has_unit(id)) {
+            cout << "Unit snapshot mismatch: unit " << id << " no longer exists" << endl;
+            continue;
+        }
+        const auto& local = unitMap[id]->unit;
+        const auto actual = gc.get_unit(id);
+        bool mismatch = local.get_location().is_on_map() != actual.get_location().is_on_map();
+        if (!mismatch && actual.get_location().is_on_map()) {
+            mismatch = local.get_location().get_map_location() != actual.get_location().get_map_location();
+        }
+        if (is_robot(actual.get_unit_type()) && local.get_health() != actual.get_health()) {
+            mismatch = true;
+        }
+        if (mismatch) {
+            cout << "Unit snapshot mismatch: unit " << id << " differs from the engine" << endl;
+        }
+    }
+}
+#endif
+
 static void safe_write(const char* str, int fd = 1) {
     size_t len = strlen(str);
     int iter = 0;
@@ -194,6 +330,31 @@ static void sighandler_timer(int sig, siginfo_t *si, void* arg) {
     fflush(stderr);
 }
 
+atomic<bool> turnDeadlinePassed(false);
+const char* preemptedPhase = nullptr;
+
+static void sighandler_deadline(int sig, siginfo_t *si, void* arg) {
+    turnDeadlinePassed.store(true, memory_order_relaxed);
+}
+
+void armTurnDeadline(double ms) {
+    turnDeadlinePassed = false;
+    preemptedPhase = nullptr;
+    // A zero timer value would disarm the timer instead
+    long usec = max(1L, (long)(ms * 1000));
+    struct itimerval tm;
+    tm.it_interval.tv_usec = 0; // one shot
+    tm.it_interval.tv_sec = 0;
+    tm.it_value.tv_usec = usec % 1000000;
+    tm.it_value.tv_sec = usec / 1000000;
+    setitimer(ITIMER_REAL, &tm, nullptr);
+}
+
+void disarmTurnDeadline() {
+    struct itimerval tm = {};
+    setitimer(ITIMER_REAL, &tm, nullptr);
+}
+
 void setup_signal_handlers() {
     struct sigaction action;
     action.sa_sigaction = &sighandler;
@@ -207,6 +368,15 @@ void setup_signal_handlers() {
 #ifdef CUSTOM_BACKTRACE
     sigaction(SIGINT,&action,nullptr);
 #endif
+
+    // Wall clock timer for the turn deadline, always installed since it is what keeps a bad turn from eating the time bank.
+    // SA_RESTART so that system calls made by the engine are not interrupted.
+    struct sigaction deadlineAction;
+    memset(&deadlineAction, 0, sizeof(deadlineAction));
+    deadlineAction.sa_sigaction = &sighandler_deadline;
+    deadlineAction.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&deadlineAction.sa_mask);
+    sigaction(SIGALRM,&deadlineAction,nullptr);
 #ifndef NDEBUG
     action.sa_sigaction = &sighandler_timer;
     sigaction(SIGVTALRM,&action,nullptr);
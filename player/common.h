@@ -6,7 +6,10 @@
 #include <iostream>
 #include <stack>
 #include <map>
+#include <deque>
 #include <functional>
+#include <atomic>
+#include <chrono>
 #include <signal.h>
 
 #define NO_IMPLICIT_COPIES
@@ -32,9 +35,8 @@ extern double unitInvalidationTime;
 extern double matchWorkersTime;
 extern double matchWorkersDijkstraTime;
 extern double matchWorkersDijkstraTime2;
-extern double hungarianTime;
+extern double assignmentTime;
 extern std::map<unsigned int, BotUnit*> unitMap;
-extern std::vector<std::vector<bool> > canSenseLocation;
 extern std::vector<std::vector<bc::Unit*> > unitAtLocation;
 
 extern bc::Team ourTeam;
@@ -121,10 +123,59 @@ extern double bestMacroObjectScore;
 void invalidate_units();
 void invalidate_unit(unsigned int id);
 
+// Targeted re-sync. Call these after performing the corresponding action, they re-read only the units
+// the action can have changed (and update unitAtLocation and the vision counts for them).
+// bc::Unit is an opaque handle into the engine with getters only, so the effects cannot be applied to the
+// snapshots locally. Re-reading the affected units is what is left to save compared to invalidate_units.
+void onMove(unsigned int robotId);
+void onBlink(unsigned int mageId);
+void onAttack(unsigned int attackerId, const bc::MapLocation& targetLocation);
+void onHeal(unsigned int healerId, unsigned int targetId);
+void onOvercharge(unsigned int healerId, unsigned int targetId);
+void onLoad(unsigned int structureId, unsigned int robotId);
+void onUnload(unsigned int structureId, unsigned int robotId);
+void onRocketLaunch(unsigned int rocketId, const std::vector<unsigned>& garrison, const bc::MapLocation& location);
+void onBuild(unsigned int workerId, unsigned int structureId);
+void onReplicate(unsigned int workerId);
+void onBlueprint(unsigned int workerId);
+
+// Units that may be able to act again this turn because something changed for them,
+// e.g. a robot that was unloaded or a rocket that was just finished.
+// The turn loop keeps ticking units from this queue until it is empty.
+// Moves do not queue anything: every unit that can move sets hasDoneTick when it ticks, so a unit whose
+// way was blocked would not tick again anyway.
+extern std::deque<unsigned int> tickQueue;
+// Set when we have created units that are not in ourUnits yet, cleared by the turn loop after it calls findUnits
+extern bool unitsCreated;
+#ifndef NDEBUG
+void verifyUnitSnapshots();
+#endif
+
 void setup_signal_handlers();
 
+// Set by a timer when the turn has run for longer than its deadline.
+// Long running loops and searches should check it and return the best result they have found so far.
+// Cheap to read and safe to read from any thread.
+extern std::atomic<bool> turnDeadlinePassed;
+// Name of the first phase that was cut short this turn, or null
+extern const char* preemptedPhase;
+
+// Start the deadline timer for this turn, clears turnDeadlinePassed
+void armTurnDeadline(double ms);
+// Stop the deadline timer, call before ending the turn
+void disarmTurnDeadline();
+
+// True if the deadline has passed. Records the phase if it is the first one to be cut short.
+// Only call from the main thread, worker threads should read turnDeadlinePassed directly.
+inline bool turnPreempted(const char* phase) {
+    if (!turnDeadlinePassed.load(std::memory_order_relaxed)) return false;
+    if (preemptedPhase == nullptr) preemptedPhase = phase;
+    return true;
+}
+
+// Wall clock time in milliseconds. clock() would add up the CPU time of all threads of the pool.
 inline double millis() {
-    return 1000.0 * (double)clock() / (double)CLOCKS_PER_SEC;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 inline bool isOnMap(bc::MapLocation location) {
@@ -5,5 +5,15 @@
 #include "rocket.cpp"
 #include "worker.cpp"
 #include "main.cpp"
-#include "hungarian.cpp"
+#include "lap.cpp"
+#include "vision.cpp"
+#include "gamecache.cpp"
+#include "karbonite.cpp"
+#include "staticmaps.cpp"
+#include "unitinfo.cpp"
+#include "parallel.cpp"
+#include "scheduler.cpp"
+#include "lazylayer.cpp"
+#include "timebudget.cpp"
+#include "timemapcache.cpp"
 
@@ -0,0 +1,134 @@
+#include "gamecache.h"
+
+using namespace bc;
+using namespace std;
+
+GameCache gameCache;
+
+const PlanetMap& GameCache::startingPlanet(Planet planet) {
+    // The engine already keeps the planet maps around, no need to copy them
+    return gc.get_starting_planet(planet);
+}
+
+const vector<Unit>& GameCache::initialUnits(Planet planet) {
+    if (hasInitialUnits[planet]) {
+        ++hits;
+    } else {
+        ++misses;
+        for (auto& unit : gc.get_starting_planet(planet).get_initial_units()) {
+            initialUnitsCache[planet].push_back(unit.clone());
+        }
+        hasInitialUnits[planet] = true;
+    }
+    return initialUnitsCache[planet];
+}
+
+const Bitboard& GameCache::terrainPassability(Planet planet) {
+    if (hasTerrain[planet]) {
+        ++hits;
+    } else {
+        ++misses;
+        auto& planetMap = gc.get_starting_planet(planet);
+        int w = planetMap.get_width();
+        int h = planetMap.get_height();
+        terrainCache[planet].clear();
+        initialKarboniteCache[planet] = vector<vector<int> >(w, vector<int>(h));
+        for (int x = 0; x < w; x++) {
+            for (int y = 0; y < h; y++) {
+                MapLocation location(planet, x, y);
+                terrainCache[planet].set(x, y, planetMap.is_passable_terrain_at(location));
+                initialKarboniteCache[planet][x][y] = planetMap.get_initial_karbonite_at(location);
+            }
+        }
+        hasTerrain[planet] = true;
+    }
+    return terrainCache[planet];
+}
+
+const vector<vector<int> >& GameCache::initialKarbonite(Planet planet) {
+    // Filled in together with the terrain
+    terrainPassability(planet);
+    return initialKarboniteCache[planet];
+}
+
+const AsteroidPattern& GameCache::asteroidPattern() {
+    if (asteroidPatternCache != nullptr) {
+        ++hits;
+    } else {
+        ++misses;
+        asteroidPatternCache = &gc.get_asteroid_pattern();
+    }
+    return *asteroidPatternCache;
+}
+
+const vector<AsteroidInfo>& GameCache::asteroids() {
+    if (hasAsteroids) {
+        ++hits;
+    } else {
+        ++misses;
+        // The game never lasts longer than this
+        const int roundLimit = 1000;
+        auto& pattern = asteroidPattern();
+        for (int round = 0; round <= roundLimit; round++) {
+            if (pattern.has_asteroid_on_round(round)) {
+                auto strike = pattern.get_asteroid_on_round(round);
+                auto location = strike.get_map_location();
+                asteroidsCache.push_back({ round, location.get_x(), location.get_y(), (int)strike.get_karbonite() });
+            }
+        }
+        hasAsteroids = true;
+    }
+    return asteroidsCache;
+}
+
+const OrbitPattern& GameCache::orbitPattern() {
+    if (orbitPatternCache != nullptr) {
+        ++hits;
+    } else {
+        ++misses;
+        orbitPatternCache = &gc.get_orbit_pattern();
+    }
+    return *orbitPatternCache;
+}
+
+UnitType GameCache::unitType(unsigned int id) {
+    auto it = unitTypeCache.find(id);
+    if (it != unitTypeCache.end()) {
+        ++hits;
+        return it->second;
+    }
+    ++misses;
+    auto type = gc.get_unit(id).get_unit_type();
+    unitTypeCache[id] = type;
+    return type;
+}
+
+const ResearchInfo& GameCache::researchInfo() {
+    if (researchInfoCache) {
+        ++hits;
+    } else {
+        ++misses;
+        researchInfoCache.reset(new ResearchInfo(gc.get_research_info()));
+    }
+    return *researchInfoCache;
+}
+
+const RocketLandingInfo& GameCache::rocketLandings() {
+    if (rocketLandingsCache) {
+        ++hits;
+    } else {
+        ++misses;
+        rocketLandingsCache.reset(new RocketLandingInfo(gc.get_rocket_landings()));
+    }
+    return *rocketLandingsCache;
+}
+
+bool GameCache::queueResearch(UnitType type) {
+    researchInfoCache.reset();
+    return gc.queue_research(type);
+}
+
+void GameCache::onNewTurn() {
+    researchInfoCache.reset();
+    rocketLandingsCache.reset();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "common.h"
+#include "bitboard.hpp"
+
+struct AsteroidInfo {
+    int round;
+    int x, y;
+    int karbonite;
+};
+
+// Memoizes read-only queries to the game controller.
+// Every query goes through the FFI and deserializes its result,
+// which adds up when the same data is requested over and over again during a turn.
+//
+// Some data never changes during the game (initial units, terrain, asteroid pattern, unit types),
+// that data is kept for the whole game.
+// Other data is only valid until the end of the turn or until we do something
+// that changes it (e.g. research info is invalidated by queueResearch).
+struct GameCache {
+    // Valid for the whole game
+    const bc::PlanetMap& startingPlanet(bc::Planet planet);
+    const std::vector<bc::Unit>& initialUnits(bc::Planet planet);
+    // Sized for the given planet, so for the other planet only Bitboard::test may be used
+    const Bitboard& terrainPassability(bc::Planet planet);
+    const std::vector<std::vector<int> >& initialKarbonite(bc::Planet planet);
+    const bc::AsteroidPattern& asteroidPattern();
+    // Plain copy of the asteroid pattern ordered by round, safe to read from other threads
+    const std::vector<AsteroidInfo>& asteroids();
+    const bc::OrbitPattern& orbitPattern();
+    // The type of a unit never changes
+    bc::UnitType unitType(unsigned int id);
+
+    // Valid until the end of the turn
+    const bc::ResearchInfo& researchInfo();
+    const bc::RocketLandingInfo& rocketLandings();
+
+    // Queues research and invalidates the research info
+    bool queueResearch(bc::UnitType type);
+
+    // Call at the start of every turn
+    void onNewTurn();
+
+    int hits = 0;
+    int misses = 0;
+
+private:
+    bool hasInitialUnits[2] = { false, false };
+    std::vector<bc::Unit> initialUnitsCache[2];
+    bool hasTerrain[2] = { false, false };
+    Bitboard terrainCache[2];
+    std::vector<std::vector<int> > initialKarboniteCache[2];
+    const bc::AsteroidPattern* asteroidPatternCache = nullptr;
+    bool hasAsteroids = false;
+    std::vector<AsteroidInfo> asteroidsCache;
+    const bc::OrbitPattern* orbitPatternCache = nullptr;
+    std::unordered_map<unsigned int, bc::UnitType> unitTypeCache;
+
+    std::unique_ptr<bc::ResearchInfo> researchInfoCache;
+    std::unique_ptr<bc::RocketLandingInfo> rocketLandingsCache;
+};
+
+extern GameCache gameCache;
@@ -30,6 +30,7 @@ double HungarianAlgorithm::Solve(vector <vector<double> >& DistMatrix, vector<in
 	double *distMatrixIn = new double[nRows * nCols];
 	int *assignment = new int[nRows];
 	double cost = 0.0;
+	cancelled = false;
 
 	// Fill in the distMatrixIn. Mind the index is "i + nRows * j".
 	// Here the cost matrix of size MxN is defined as a double precision array of N*M elements. 
@@ -255,6 +256,12 @@ void HungarianAlgorithm::step2b(int *assignment, double *distMatrix, bool *starM
 		/* algorithm finished */
 		buildassignmentvector(assignment, starMatrix, nOfRows, nOfColumns);
 	}
+	else if (cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed))
+	{
+		/* out of time, keep the starred zeros found so far */
+		cancelled = true;
+		buildassignmentvector(assignment, starMatrix, nOfRows, nOfColumns);
+	}
 	else
 	{
 		/* move to step 3 */
@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <vector>
+#include <atomic>
 
 using namespace std;
 
@@ -25,6 +26,11 @@ public:
 	~HungarianAlgorithm();
 	double Solve(vector <vector<double> >& DistMatrix, vector<int>& Assignment);
 
+	// If set, the solve is abandoned when the flag becomes true.
+	// The assignment is then only partial (unassigned rows are -1) and cancelled is set.
+	const std::atomic<bool>* cancelFlag = nullptr;
+	bool cancelled = false;
+
 private:
 	void assignmentoptimal(int *assignment, double *cost, double *distMatrix, int nOfRows, int nOfColumns);
 	void buildassignmentvector(int *assignment, bool *starMatrix, int nOfRows, int nOfColumns);
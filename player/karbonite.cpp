@@ -0,0 +1,210 @@
+#include "karbonite.h"
+#include "maps.h"
+#include "gamecache.h"
+
+#include <queue>
+#include <algorithm>
+
+using namespace bc;
+using namespace std;
+
+KarboniteIndex karboniteIndex;
+KarboniteClusters karboniteClusters;
+
+void KarboniteIndex::init() {
+    karboniteMap = PathfindingMap(w, h);
+    tiles.clear();
+    hasKarbonite.clear();
+    karboniteClusters.clear();
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) {
+            indexOf[x][y] = -1;
+            contestWeight[x][y] = 0;
+            reachableWeight[x][y] = 1;
+        }
+    }
+
+    auto& initialKarbonite = gameCache.initialKarbonite(planet);
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) {
+            set(x, y, initialKarbonite[x][y]);
+        }
+    }
+}
+
+void KarboniteIndex::computeWeights() {
+    if (planet == Earth) {
+        for (int x = 0; x < w; x++) {
+            for (int y = 0; y < h; y++) {
+                int disDiff = distanceToInitialLocation[enemyTeam].weights[x][y] - distanceToInitialLocation[ourTeam].weights[x][y];
+                if (disDiff <= 4 && disDiff >= -4) {
+                    contestWeight[x][y] = 1;
+                } else if (disDiff <= 5 && disDiff >= -5) {
+                    contestWeight[x][y] = 0.5f;
+                } else {
+                    contestWeight[x][y] = 0;
+                }
+                reachableWeight[x][y] = distanceToInitialLocation[ourTeam].weights[x][y] > 200 ? 0 : 1;
+            }
+        }
+    }
+    recomputeAggregates();
+}
+
+void KarboniteIndex::recomputeAggregates() {
+    total = 0;
+    contested = 0;
+    reachable = 0;
+    for (auto& tile : tiles) {
+        double karbonite = karboniteMap.weights[tile.first][tile.second];
+        total += karbonite;
+        contested += karbonite * contestWeight[tile.first][tile.second];
+        reachable += karbonite * reachableWeight[tile.first][tile.second];
+    }
+}
+
+void KarboniteIndex::set(int x, int y, double karbonite) {
+    double previous = karboniteMap.weights[x][y];
+    double delta = karbonite - previous;
+    total += delta;
+    contested += delta * contestWeight[x][y];
+    reachable += delta * reachableWeight[x][y];
+    karboniteMap.weights[x][y] = karbonite;
+    if (delta != 0) {
+        karboniteClusters.tileChanged(x, y, previous, karbonite);
+    }
+
+    if (karbonite > 0 && indexOf[x][y] == -1) {
+        indexOf[x][y] = tiles.size();
+        tiles.push_back(pii(x, y));
+        hasKarbonite.set(x, y);
+    } else if (karbonite <= 0 && indexOf[x][y] != -1) {
+        // Swap with the last tile and remove
+        int index = indexOf[x][y];
+        auto last = tiles.back();
+        tiles[index] = last;
+        indexOf[last.first][last.second] = index;
+        tiles.pop_back();
+        indexOf[x][y] = -1;
+        hasKarbonite.reset(x, y);
+    }
+}
+
+void KarboniteClusters::clear() {
+    groupList.clear();
+    changedGroups.clear();
+    ungrouped.clear();
+    for (int x = 0; x < MAX_MAP_SIZE; x++) {
+        for (int y = 0; y < MAX_MAP_SIZE; y++) {
+            groupOf[x][y] = -1;
+            visitMark[x][y] = 0;
+        }
+    }
+    visitVersion = 0;
+}
+
+void KarboniteClusters::tileChanged(int x, int y, double previous, double karbonite) {
+    int group = groupOf[x][y];
+    if (group == -1) {
+        ungrouped.set(x, y, karbonite > 0);
+        return;
+    }
+
+    groupList[group].totalKarbonite += karbonite - previous;
+    // Less karbonite on a tile that is not mined out only makes the group a bit smaller than it could be
+    if (karbonite <= 0 || karbonite > previous) {
+        changedGroups.push_back(group);
+    }
+}
+
+void KarboniteClusters::dissolve(int group) {
+    for (auto p : groupList[group].tiles) {
+        groupOf[p.first][p.second] = -1;
+        if (karboniteMap.weights[p.first][p.second] > 0) ungrouped.set(p.first, p.second);
+    }
+
+    // Swap with the last group and remove
+    if (group != (int)groupList.size() - 1) {
+        groupList[group] = move(groupList.back());
+        for (auto p : groupList[group].tiles) groupOf[p.first][p.second] = group;
+    }
+    groupList.pop_back();
+}
+
+void KarboniteClusters::update(int miningSpeed) {
+    if (miningSpeed != lastMiningSpeed) {
+        // The size of every group depends on it
+        lastMiningSpeed = miningSpeed;
+        while (!groupList.empty()) dissolve(groupList.size() - 1);
+        changedGroups.clear();
+    }
+
+    // Highest index first, dissolve moves the last group into the removed slot and that group must not be one we still have to remove
+    sort(changedGroups.rbegin(), changedGroups.rend());
+    changedGroups.erase(unique(changedGroups.begin(), changedGroups.end()), changedGroups.end());
+    for (int group : changedGroups) dissolve(group);
+    changedGroups.clear();
+
+    if (ungrouped.popcount() == 0) return;
+    auto seeds = ungrouped;
+    seeds.forEach([&](int x, int y) {
+        if (groupOf[x][y] == -1) grow(x, y, miningSpeed);
+    });
+    ungrouped.clear();
+}
+
+// Adds tiles in breadth first order until the group is estimated to take maxTimeCost turns to mine.
+// Tiles without karbonite are only added when there are no karbonite tiles left to reach.
+void KarboniteClusters::grow(int x, int y, int miningSpeed) {
+    int index = groupList.size();
+    groupList.push_back(KarboniteGroup());
+    auto& group = groupList.back();
+
+    visitVersion++;
+    queue<pii> que1;
+    queue<pii> que2;
+    que1.push(pii(x, y));
+    visitMark[x][y] = visitVersion;
+    int timeCost = 0;
+
+    while (timeCost < maxTimeCost) {
+        if (que1.empty()) {
+            swap(que1, que2);
+        }
+        if (que1.empty()) break;
+
+        pii p = que1.front();
+        que1.pop();
+
+        double karbonite = karboniteMap.weights[p.first][p.second];
+        int timeToMine = (karbonite + (miningSpeed-1)) / miningSpeed;
+        // Workers can move every second turn so we will have to spend at least 2 turns here
+        timeToMine = max(timeToMine, 2);
+        timeCost += timeToMine;
+
+        group.tiles.push_back(p);
+        group.totalKarbonite += karbonite;
+        groupOf[p.first][p.second] = index;
+
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                int nx = p.first + dx;
+                int ny = p.second + dy;
+                if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                if (visitMark[nx][ny] == visitVersion || groupOf[nx][ny] != -1) continue;
+
+                // TODO: What about karbonite inside walls? That can be mined in some cases
+                if (!passableTerrain.test(nx, ny)) continue;
+
+                visitMark[nx][ny] = visitVersion;
+
+                // Try to avoid adding non-karbonite tiles to the group if possible
+                if (karboniteMap.weights[nx][ny] == 0) {
+                    que2.push(pii(nx,ny));
+                } else {
+                    que1.push(pii(nx,ny));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common.h"
+#include "bitboard.hpp"
+
+// Sparse index of all tiles which (as far as we know) contain karbonite.
+// Karbonite is mined out over the course of the game, so iterating over this
+// is a lot cheaper than iterating over the whole map.
+//
+// All writes to karboniteMap should go through set so that the index stays in sync.
+struct KarboniteIndex {
+    // Tiles with karbonite, in no particular order
+    std::vector<pii> tiles;
+    Bitboard hasKarbonite;
+
+    // Sum of all karbonite in the index
+    double total = 0;
+    // Sum of karbonite that is roughly equally close to us and the enemy, see contestWeight
+    double contested = 0;
+    // Sum of karbonite that we can actually get to
+    double reachable = 0;
+
+    // Read the initial karbonite of the planet
+    void init();
+    // Call when the distances to the initial locations are known
+    void computeWeights();
+    // Set the amount of karbonite on a tile, also updates karboniteMap
+    void set(int x, int y, double karbonite);
+
+private:
+    int indexOf[MAX_MAP_SIZE][MAX_MAP_SIZE];
+    // Contribution of a karbonite unit on a tile to the aggregates
+    float contestWeight[MAX_MAP_SIZE][MAX_MAP_SIZE];
+    float reachableWeight[MAX_MAP_SIZE][MAX_MAP_SIZE];
+
+    void recomputeAggregates();
+};
+
+extern KarboniteIndex karboniteIndex;
+
+// Tiles that a few workers can mine together, see KarboniteClusters
+struct KarboniteGroup {
+    // The tile the group was grown from comes first. May include tiles without karbonite that connect the others.
+    std::vector<pii> tiles;
+    // Sum of the karbonite on the tiles
+    double totalKarbonite = 0;
+};
+
+// Groups of nearby karbonite tiles, each about as much as a worker can mine in maxTimeCost turns.
+//
+// The groups are kept between turns. KarboniteIndex::set reports every change, and only the groups whose tiles
+// changed in a way that can change their shape (mined out or added to) are marked. The next update dissolves them
+// and grows them again from their remaining tiles, together with karbonite that is not in any group yet.
+// Mining a tile without emptying it only updates the total of its group.
+// Groups are grown over passable terrain, so a group may include tiles that our structures stand on.
+struct KarboniteClusters {
+    // Turns of mining per group
+    int maxTimeCost = 30;
+
+    // Grows the groups that were dissolved since the last call. Cheap when nothing changed.
+    void update(int miningSpeed);
+    // Groups by index. Groups are only removed by update, so the indices are valid until the next update.
+    // A group that has changed keeps its index (and its old tiles) until then.
+    const std::vector<KarboniteGroup>& groups() const { return groupList; }
+    // Index of the group the tile belongs to, or -1
+    int groupAt(int x, int y) const { return groupOf[x][y]; }
+
+    // Called by KarboniteIndex
+    void clear();
+    void tileChanged(int x, int y, double previous, double karbonite);
+
+private:
+    std::vector<KarboniteGroup> groupList;
+    // Groups to dissolve in the next update, may contain duplicates
+    std::vector<int> changedGroups;
+    int groupOf[MAX_MAP_SIZE][MAX_MAP_SIZE];
+    // Karbonite tiles that are not in any group
+    Bitboard ungrouped;
+    // Tiles visited by the group that is being grown have visitMark == visitVersion
+    int visitMark[MAX_MAP_SIZE][MAX_MAP_SIZE];
+    int visitVersion = 0;
+    int lastMiningSpeed = -1;
+
+    void dissolve(int group);
+    void grow(int x, int y, int miningSpeed);
+};
+
+extern KarboniteClusters karboniteClusters;
@@ -0,0 +1,577 @@
+#include "lap.h"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <fstream>
+#include <cmath>
+#include <functional>
+#include <cassert>
+
+using namespace std;
+
+static const double LAP_INF = numeric_limits<double>::infinity();
+
+bool LapSolver::loadCosts(int n, int m, const function<double(int, int)>& entry) {
+    if (n == 0 || m == 0) return false;
+
+    // The solvers assume rows <= cols
+    bool transposed = n > m;
+    rows = min(n, m);
+    cols = max(n, m);
+    cost.resize(rows * cols);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            if (transposed) cost[j * cols + i] = entry(i, j);
+            else cost[i * cols + j] = entry(i, j);
+        }
+    }
+    colForRow.assign(rows, -1);
+    return true;
+}
+
+double LapSolver::readAssignment(vector<int>& assignment, bool transposed) {
+    double total = 0;
+    for (int r = 0; r < rows; r++) {
+        int c = colForRow[r];
+        if (c == -1) continue;
+        if (transposed) assignment[c] = r;
+        else assignment[r] = c;
+        total += cost[r * cols + c];
+    }
+    return total;
+}
+
+double LapSolver::solve(const vector<vector<double> >& costs, vector<int>& assignment, Method method) {
+    cancelled = false;
+    augmentations = 0;
+    assignment.assign(costs.size(), -1);
+    if (!loadCosts(costs.size(), costs.empty() ? 0 : costs[0].size(), [&](int i, int j) { return costs[i][j]; })) return 0;
+
+    if (method == Method::Auction) {
+        auction();
+    } else {
+        rowPotential.assign(rows + 1, 0);
+        colPotential.assign(cols + 1, 0);
+        rowForCol.assign(cols + 1, 0);
+        shortestPath();
+    }
+    return readAssignment(assignment, costs.size() > costs[0].size());
+}
+
+double LapSolver::solveSparse(const vector<vector<pair<int, double> > >& candidates, const vector<vector<double> >& marginalCosts, const vector<int64_t>& rowKeys, const vector<int64_t>& colKeys, double unassignedCost, vector<int>& assignment) {
+    cancelled = false;
+    augmentations = 0;
+    int n = candidates.size();
+    assignment.assign(n, -1);
+
+    // One unit capacity slot per row that a column can take, followed by one private slot per row for staying unassigned
+    vector<int> firstSlot(marginalCosts.size() + 1);
+    vector<int> slotColumn;
+    vector<int64_t> slotKeys;
+    for (int j = 0; j < (int)marginalCosts.size(); j++) {
+        firstSlot[j] = slotColumn.size();
+        int capacity = min((int)marginalCosts[j].size(), MAX_CAPACITY);
+        for (int k = 0; k < capacity; k++) {
+            slotColumn.push_back(j);
+            slotKeys.push_back(colKeys[j] * MAX_CAPACITY + k);
+        }
+    }
+    firstSlot[marginalCosts.size()] = slotColumn.size();
+    int numSlots = slotColumn.size();
+    for (int i = 0; i < n; i++) {
+        slotKeys.push_back(-1 - rowKeys[i]);
+    }
+    rows = n;
+    cols = numSlots + n;
+
+    edgeStart.assign(1, 0);
+    edgeCol.clear();
+    edgeCost.clear();
+    for (int i = 0; i < n; i++) {
+        for (auto& candidate : candidates[i]) {
+            int j = candidate.first;
+            for (int slot = firstSlot[j]; slot < firstSlot[j + 1]; slot++) {
+                edgeCol.push_back(slot);
+                edgeCost.push_back(candidate.second + marginalCosts[j][slot - firstSlot[j]]);
+            }
+        }
+        edgeCol.push_back(numSlots + i);
+        edgeCost.push_back(unassignedCost);
+        edgeStart.push_back(edgeCol.size());
+    }
+
+    sparseWarmStart(rowKeys, slotKeys);
+    sparseShortestPath();
+
+    warmColPotential.clear();
+    warmMatch.clear();
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        int slot = colForRow[i];
+        if (slot == -1) continue;
+        warmMatch[rowKeys[i]] = slotKeys[slot];
+        if (slot < numSlots) {
+            assignment[i] = slotColumn[slot];
+        }
+        total += matchCost[i];
+    }
+    for (int slot = 0; slot < cols; slot++) {
+        if (colPotential[slot] != 0) warmColPotential[slotKeys[slot]] = colPotential[slot];
+    }
+    return total;
+}
+
+// The potentials must stay dual feasible (reduced costs >= 0), be tight on the matched pairs
+// and be zero on the unmatched slots. Previous matches that are no longer tight are dropped,
+// which makes their slots unmatched, which may make other matches not tight anymore, and so on.
+// This usually settles after one or two rounds.
+void LapSolver::sparseWarmStart(const vector<int64_t>& rowKeys, const vector<int64_t>& slotKeys) {
+    rowPotential.assign(rows, 0);
+    colPotential.assign(cols, 0);
+    rowForCol.assign(cols, -1);
+    colForRow.assign(rows, -1);
+    matchCost.assign(rows, 0);
+
+    unordered_map<int64_t, int> slotIndex;
+    for (int slot = 0; slot < cols; slot++) {
+        slotIndex[slotKeys[slot]] = slot;
+        auto it = warmColPotential.find(slotKeys[slot]);
+        if (it != warmColPotential.end()) colPotential[slot] = min(0.0, it->second);
+    }
+    for (int row = 0; row < rows; row++) {
+        auto match = warmMatch.find(rowKeys[row]);
+        if (match == warmMatch.end()) continue;
+        auto slot = slotIndex.find(match->second);
+        if (slot == slotIndex.end() || rowForCol[slot->second] != -1) continue;
+        // The slot must still be a candidate for the row
+        for (int e = edgeStart[row]; e < edgeStart[row + 1]; e++) {
+            if (edgeCol[e] == slot->second) {
+                rowForCol[slot->second] = row;
+                colForRow[row] = slot->second;
+                matchCost[row] = edgeCost[e];
+            }
+        }
+    }
+
+    while (true) {
+        for (int slot = 0; slot < cols; slot++) {
+            if (rowForCol[slot] == -1) colPotential[slot] = 0;
+        }
+        bool dropped = false;
+        for (int row = 0; row < rows; row++) {
+            double potential = LAP_INF;
+            for (int e = edgeStart[row]; e < edgeStart[row + 1]; e++) {
+                potential = min(potential, edgeCost[e] - colPotential[edgeCol[e]]);
+            }
+            rowPotential[row] = potential;
+        }
+        for (int row = 0; row < rows; row++) {
+            int slot = colForRow[row];
+            if (slot == -1) continue;
+            double c = matchCost[row];
+            if (c - rowPotential[row] - colPotential[slot] > 1e-9 * (1 + fabs(c))) {
+                rowForCol[slot] = -1;
+                colForRow[row] = -1;
+                dropped = true;
+            }
+        }
+        if (!dropped) break;
+    }
+}
+
+// Dijkstra over the columns from the row that is being added, with lazy deletion from the heap.
+// Afterwards the potentials of the columns that were reached are lowered by how much shorter their path was
+// than the augmenting path, which keeps the reduced costs non-negative (as in Jonker-Volgenant).
+void LapSolver::sparseShortestPath() {
+    distance.assign(cols, LAP_INF);
+    reachedFrom.assign(cols, -1);
+    reachedCost.assign(cols, 0);
+    visited.assign(cols, 0);
+    typedef pair<double, int> Entry;
+    // Heap ordered by distance, kept as a vector so that the storage is reused
+    vector<Entry> queue;
+
+    for (int row = 0; row < rows; row++) {
+        if (colForRow[row] != -1) continue;
+        if (checkCancelled()) break;
+        augmentations++;
+
+        double potential = LAP_INF;
+        int tightEdge = -1;
+        for (int e = edgeStart[row]; e < edgeStart[row + 1]; e++) {
+            double reduced = edgeCost[e] - colPotential[edgeCol[e]];
+            if (reduced < potential) {
+                potential = reduced;
+                tightEdge = e;
+            }
+        }
+        rowPotential[row] = potential;
+
+        // Usually the best column is still free and no search is needed
+        if (rowForCol[edgeCol[tightEdge]] == -1) {
+            rowForCol[edgeCol[tightEdge]] = row;
+            colForRow[row] = edgeCol[tightEdge];
+            matchCost[row] = edgeCost[tightEdge];
+            continue;
+        }
+
+        touched.clear();
+        auto relax = [&](int from, double fromDistance) {
+            for (int e = edgeStart[from]; e < edgeStart[from + 1]; e++) {
+                int col = edgeCol[e];
+                if (visited[col]) continue;
+                double d = fromDistance + edgeCost[e] - rowPotential[from] - colPotential[col];
+                if (d < distance[col]) {
+                    if (distance[col] == LAP_INF) touched.push_back(col);
+                    distance[col] = d;
+                    reachedFrom[col] = from;
+                    reachedCost[col] = edgeCost[e];
+                    queue.push_back(Entry(d, col));
+                    push_heap(queue.begin(), queue.end(), greater<Entry>());
+                }
+            }
+        };
+        relax(row, 0);
+
+        int endCol = -1;
+        vector<int> settled;
+        while (!queue.empty()) {
+            pop_heap(queue.begin(), queue.end(), greater<Entry>());
+            auto entry = queue.back();
+            queue.pop_back();
+            int col = entry.second;
+            if (visited[col] || entry.first > distance[col]) continue;
+            visited[col] = 1;
+            settled.push_back(col);
+            if (rowForCol[col] == -1) {
+                endCol = col;
+                break;
+            }
+            relax(rowForCol[col], distance[col]);
+        }
+        queue.clear();
+        // Every row has its private slot, so there is always a free column
+        assert(endCol != -1);
+
+        double pathLength = distance[endCol];
+        for (int col : settled) {
+            colPotential[col] -= pathLength - distance[col];
+        }
+
+        // Flip the augmenting path
+        int col = endCol;
+        while (true) {
+            int r = reachedFrom[col];
+            int previousCol = colForRow[r];
+            rowForCol[col] = r;
+            colForRow[r] = col;
+            matchCost[r] = reachedCost[col];
+            if (r == row) break;
+            col = previousCol;
+        }
+
+        // Keep the matched edges tight
+        for (int c : settled) {
+            int r = rowForCol[c];
+            if (r != -1) rowPotential[r] = matchCost[r] - colPotential[c];
+        }
+
+        for (int c : touched) {
+            distance[c] = LAP_INF;
+            visited[c] = 0;
+        }
+    }
+}
+
+bool LapSolver::checkCancelled() {
+    if (cancelFlag != nullptr && cancelFlag->load(memory_order_relaxed)) {
+        cancelled = true;
+    }
+    return cancelled;
+}
+
+// Adds one row at a time and augments along the shortest path in the reduced costs (Dijkstra over the columns).
+// The potentials keep all reduced costs non-negative and are zero on the matched edges.
+// Index 0 is used as a virtual column for the row that is being added, rows and columns are 1-indexed.
+void LapSolver::shortestPath() {
+    previousCol.assign(cols + 1, 0);
+    minSlack.resize(cols + 1);
+    visited.resize(cols + 1);
+
+    vector<char> rowMatched(rows + 1);
+    for (int col = 1; col <= cols; col++) {
+        rowMatched[rowForCol[col]] = 1;
+    }
+    vector<int> unmatchedRows;
+    for (int row = 1; row <= rows; row++) {
+        if (!rowMatched[row]) unmatchedRows.push_back(row);
+    }
+
+    for (int row : unmatchedRows) {
+        if (checkCancelled()) break;
+        augmentations++;
+
+        rowForCol[0] = row;
+        int col0 = 0;
+        fill(minSlack.begin(), minSlack.end(), LAP_INF);
+        fill(visited.begin(), visited.end(), 0);
+        do {
+            visited[col0] = 1;
+            int row0 = rowForCol[col0];
+            const double* rowCosts = &cost[(row0 - 1) * cols];
+            double delta = LAP_INF;
+            int col1 = 0;
+            for (int col = 1; col <= cols; col++) {
+                if (visited[col]) continue;
+                double slack = rowCosts[col - 1] - rowPotential[row0] - colPotential[col];
+                if (slack < minSlack[col]) {
+                    minSlack[col] = slack;
+                    previousCol[col] = col0;
+                }
+                if (minSlack[col] < delta) {
+                    delta = minSlack[col];
+                    col1 = col;
+                }
+            }
+            for (int col = 0; col <= cols; col++) {
+                if (visited[col]) {
+                    rowPotential[rowForCol[col]] += delta;
+                    colPotential[col] -= delta;
+                } else {
+                    minSlack[col] -= delta;
+                }
+            }
+            col0 = col1;
+        } while (rowForCol[col0] != 0);
+
+        // Flip the augmenting path
+        do {
+            int col1 = previousCol[col0];
+            rowForCol[col0] = rowForCol[col1];
+            col0 = col1;
+        } while (col0 != 0);
+    }
+
+    for (int col = 1; col <= cols; col++) {
+        if (rowForCol[col] != 0) colForRow[rowForCol[col] - 1] = col - 1;
+    }
+}
+
+// Gauss-Seidel auction for maximum benefit (= -cost) with epsilon scaling.
+// The problem is made square with dummy rows that have zero benefit for every column,
+// so that the columns that are left over end up with the dummies.
+void LapSolver::auction() {
+    double minCost = LAP_INF;
+    double maxCost = -LAP_INF;
+    for (double c : cost) {
+        minCost = min(minCost, c);
+        maxCost = max(maxCost, c);
+    }
+    double range = max(maxCost - minCost, 1e-9);
+    // The result is within cols * finalEpsilon of the optimum
+    double finalEpsilon = range * 1e-7 / cols;
+    double epsilon = range / 4;
+    const double epsilonFactor = 5;
+
+    prices.assign(cols, 0);
+    vector<int>& assignedCol = previousCol;
+    rowForCol.resize(cols);
+    int bids = 0;
+    while (true) {
+        assignedCol.assign(cols, -1);
+        fill(rowForCol.begin(), rowForCol.end(), -1);
+        unassigned.clear();
+        for (int i = cols - 1; i >= 0; i--) unassigned.push_back(i);
+
+        while (!unassigned.empty()) {
+            if ((++bids & 255) == 0 && checkCancelled()) break;
+
+            int row = unassigned.back();
+            unassigned.pop_back();
+            double best = -LAP_INF;
+            double secondBest = -LAP_INF;
+            int bestCol = 0;
+            for (int col = 0; col < cols; col++) {
+                double benefit = row < rows ? -cost[row * cols + col] : 0;
+                double value = benefit - prices[col];
+                if (value > best) {
+                    secondBest = best;
+                    best = value;
+                    bestCol = col;
+                } else if (value > secondBest) {
+                    secondBest = value;
+                }
+            }
+            if (secondBest == -LAP_INF) secondBest = best;
+
+            prices[bestCol] += best - secondBest + epsilon;
+            int previousOwner = rowForCol[bestCol];
+            if (previousOwner != -1) {
+                assignedCol[previousOwner] = -1;
+                unassigned.push_back(previousOwner);
+            }
+            rowForCol[bestCol] = row;
+            assignedCol[row] = bestCol;
+        }
+
+        if (cancelled || epsilon <= finalEpsilon) break;
+        epsilon = max(epsilon / epsilonFactor, finalEpsilon);
+    }
+
+    for (int row = 0; row < rows; row++) {
+        colForRow[row] = assignedCol[row];
+    }
+}
+
+double greedyWeightedMatching(vector<vector<double> >& costs, vector<int>& assignment) {
+    assignment.resize(costs.size());
+    vector<tuple<double,int,int>> costOrder;
+    vector<bool> usedTargets(costs[0].size());
+    for (int i = 0; i < (int)costs.size(); i++) {
+        assignment[i] = -1;
+
+        for (int j = 0; j < (int)costs[i].size(); j++) {
+            costOrder.push_back(make_tuple(costs[i][j], i, j));
+        }
+    }
+    double totalCost = 0;
+    sort(costOrder.begin(), costOrder.end());
+    for (auto tup : costOrder) {
+        double cost;
+        int i, j;
+        tie(cost, i, j) = tup;
+
+        if (assignment[i] != -1 || usedTargets[j]) continue;
+
+        usedTargets[j] = true;
+        assignment[i] = j;
+        totalCost += cost;
+    }
+    return totalCost;
+}
+
+double greedyCapacitatedMatching(const vector<vector<double> >& costs, const vector<vector<double> >& marginalCosts, vector<int>& assignment) {
+    assignment.assign(costs.size(), -1);
+    vector<tuple<double,int,int>> costOrder;
+    for (int i = 0; i < (int)costs.size(); i++) {
+        for (int j = 0; j < (int)costs[i].size(); j++) {
+            costOrder.push_back(make_tuple(costs[i][j], i, j));
+        }
+    }
+    vector<int> load(marginalCosts.size());
+    double totalCost = 0;
+    sort(costOrder.begin(), costOrder.end());
+    for (auto tup : costOrder) {
+        double cost;
+        int i, j;
+        tie(cost, i, j) = tup;
+
+        if (assignment[i] != -1 || load[j] >= (int)marginalCosts[j].size()) continue;
+
+        assignment[i] = j;
+        totalCost += cost + marginalCosts[j][load[j]];
+        load[j]++;
+    }
+    return totalCost;
+}
+
+vector<vector<int> > selectCandidates(const vector<vector<double> >& bounds, int numCandidates) {
+    int n = bounds.size();
+    int m = bounds.empty() ? 0 : bounds[0].size();
+    vector<vector<char> > isCandidate(n, vector<char>(m));
+    vector<pair<double, int> > order;
+    for (int i = 0; i < n; i++) {
+        order.clear();
+        for (int j = 0; j < m; j++) {
+            if (bounds[i][j] >= 0) order.push_back(make_pair(-bounds[i][j], j));
+        }
+        int count = min(numCandidates, (int)order.size());
+        partial_sort(order.begin(), order.begin() + count, order.end());
+        for (int k = 0; k < count; k++) isCandidate[i][order[k].second] = true;
+    }
+    for (int j = 0; j < m; j++) {
+        order.clear();
+        for (int i = 0; i < n; i++) {
+            if (bounds[i][j] >= 0) order.push_back(make_pair(-bounds[i][j], i));
+        }
+        int count = min(numCandidates, (int)order.size());
+        partial_sort(order.begin(), order.begin() + count, order.end());
+        for (int k = 0; k < count; k++) isCandidate[order[k].second][j] = true;
+    }
+
+    vector<vector<int> > candidates(n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            if (isCandidate[i][j]) candidates[i].push_back(j);
+        }
+    }
+    return candidates;
+}
+
+bool writeMatchingProblem(const string& path, const MatchingProblem& problem) {
+    ofstream out(path);
+    if (!out) return false;
+    out.precision(17);
+    auto& costs = problem.costs;
+    out << costs.size() << " " << (costs.empty() ? 0 : costs[0].size()) << "\n";
+    for (auto& row : costs) {
+        for (double c : row) out << c << " ";
+        out << "\n";
+    }
+    out << problem.unassignedCost << " " << problem.impossibleCost << "\n";
+    for (auto& column : problem.marginalCosts) {
+        out << column.size();
+        for (double c : column) out << " " << c;
+        out << "\n";
+    }
+    for (auto& row : problem.candidates) {
+        out << row.size();
+        for (int j : row) out << " " << j;
+        out << "\n";
+    }
+    return (bool)out;
+}
+
+bool readMatchingProblem(const string& path, MatchingProblem& problem) {
+    ifstream in(path);
+    int n, m;
+    if (!(in >> n >> m) || n < 0 || m < 0) return false;
+    auto& costs = problem.costs;
+    costs.assign(n, vector<double>(m));
+    double maxCost = 0;
+    for (auto& row : costs) {
+        for (double& c : row) {
+            if (!(in >> c)) return false;
+            maxCost = max(maxCost, c);
+        }
+    }
+
+    problem.candidates.clear();
+    if (!(in >> problem.unassignedCost >> problem.impossibleCost)) {
+        // Only the costs were recorded. Unreachable pairs were given the highest cost.
+        problem.unassignedCost = maxCost;
+        problem.impossibleCost = maxCost;
+        problem.marginalCosts.assign(m, vector<double>(1, 0));
+        return true;
+    }
+    problem.marginalCosts.assign(m, vector<double>());
+    for (auto& column : problem.marginalCosts) {
+        int capacity;
+        if (!(in >> capacity) || capacity < 0) return false;
+        column.resize(capacity);
+        for (double& c : column) {
+            if (!(in >> c)) return false;
+        }
+    }
+    problem.candidates.assign(n, vector<int>());
+    for (auto& row : problem.candidates) {
+        int count;
+        if (!(in >> count) || count < 0) return false;
+        row.resize(count);
+        for (int& j : row) {
+            if (!(in >> j) || j < 0 || j >= m) return false;
+        }
+    }
+    return true;
+}
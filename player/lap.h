@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <functional>
+
+// Solver for the rectangular linear assignment problem.
+//
+// Given an n x m cost matrix, assigns min(n, m) rows to distinct columns such that the total cost is minimized.
+// The default method is shortest augmenting paths with dual potentials (as in Jonker-Volgenant), which is exact
+// and takes O(min(n,m)^2 max(n,m)) time. The auction method with epsilon scaling is approximate
+// (within min(n,m) times the final epsilon of the optimum) but is often faster on large sparse-ish problems.
+//
+// The workspace is kept between calls, so keep the solver around instead of creating a new one every turn.
+// Does not depend on the rest of the bot, so that it can be benchmarked on its own (see lapbench.cpp).
+struct LapSolver {
+    enum class Method { ShortestPath, Auction };
+
+    // Returns the total cost. assignment[i] is the column assigned to row i, or -1.
+    double solve(const std::vector<std::vector<double> >& costs, std::vector<int>& assignment, Method method = Method::ShortestPath);
+
+    // Assignment where column j can take up to marginalCosts[j].size() rows, and the k-th row assigned to it
+    // costs marginalCosts[j][k] on top of the cost of the pair. This is min cost flow with convex costs on the columns.
+    // candidates[i] lists the columns row i may be assigned to together with their costs.
+    // Every row may also stay unassigned at unassignedCost, so the problem is always feasible.
+    // Every column is split into one unit capacity slot per row it can take, so the marginal costs must be
+    // non-decreasing for the slots to be filled in order. Augmenting paths are found with Dijkstra over the
+    // candidate edges only, so a solve takes O(augmentations * E log E) time where E is the number of candidate slots.
+    //
+    // Starts from the potentials and the matching of the previous call. Rows and columns are identified across
+    // calls by their keys, column keys must be non-negative. The previous matches that are still optimal for the
+    // new costs are kept, so only the rows that were added or whose match changed need to be augmented.
+    double solveSparse(const std::vector<std::vector<std::pair<int, double> > >& candidates, const std::vector<std::vector<double> >& marginalCosts, const std::vector<int64_t>& rowKeys, const std::vector<int64_t>& colKeys, double unassignedCost, std::vector<int>& assignment);
+
+    // Number of augmenting paths the last solve needed
+    int augmentations = 0;
+
+    // If set, the solve is abandoned when the flag becomes true.
+    // The assignment is then only partial and cancelled is set.
+    const std::atomic<bool>* cancelFlag = nullptr;
+    bool cancelled = false;
+
+private:
+    // Row major costs, transposed if there are more rows than columns so that rows <= cols
+    std::vector<double> cost;
+    int rows = 0;
+    int cols = 0;
+    // Dual potentials
+    std::vector<double> rowPotential;
+    std::vector<double> colPotential;
+    std::vector<double> minSlack;
+    std::vector<int> rowForCol;
+    std::vector<int> colForRow;
+    std::vector<int> previousCol;
+    std::vector<char> visited;
+    // Auction
+    std::vector<double> prices;
+    std::vector<int> unassigned;
+    // Sparse problems, in compressed row format
+    std::vector<int> edgeStart;
+    std::vector<int> edgeCol;
+    std::vector<double> edgeCost;
+    std::vector<double> matchCost;
+    std::vector<double> distance;
+    std::vector<int> reachedFrom;
+    std::vector<double> reachedCost;
+    std::vector<int> touched;
+    // State kept for solveSparse, by key
+    std::unordered_map<int64_t, double> warmColPotential;
+    std::unordered_map<int64_t, int64_t> warmMatch;
+
+    // Columns can take at most this many rows in solveSparse
+    static const int MAX_CAPACITY = 64;
+
+    bool checkCancelled();
+    bool loadCosts(int n, int m, const std::function<double(int, int)>& entry);
+    double readAssignment(std::vector<int>& assignment, bool transposed);
+    // Augments all rows that are not matched yet, starting from the current potentials
+    void shortestPath();
+    // Restores the state kept by the previous solveSparse and repairs it for the new costs, potentials are 0-indexed
+    void sparseWarmStart(const std::vector<int64_t>& rowKeys, const std::vector<int64_t>& slotKeys);
+    void sparseShortestPath();
+    void auction();
+};
+
+// Assigns in order of increasing cost. Fast, but can be far from optimal.
+double greedyWeightedMatching(std::vector<std::vector<double> >& costs, std::vector<int>& assignment);
+// Same for the capacitated problem, see LapSolver::solveSparse
+double greedyCapacitatedMatching(const std::vector<std::vector<double> >& costs, const std::vector<std::vector<double> >& marginalCosts, std::vector<int>& assignment);
+
+// Picks the pairs a sparse assignment considers: the numCandidates best columns of every row and the numCandidates
+// best rows of every column, ranked by bounds[i][j] (higher is better). Pairs with a negative bound are never candidates.
+std::vector<std::vector<int> > selectCandidates(const std::vector<std::vector<double> >& bounds, int numCandidates);
+
+// A capacitated assignment problem as the worker matching passes it to solveSparse, but with the cost of every pair.
+// Pairs that cost impossibleCost or more cannot be assigned. candidates are the pairs the bot selected, they may be empty.
+struct MatchingProblem {
+    std::vector<std::vector<double> > costs;
+    std::vector<std::vector<double> > marginalCosts;
+    std::vector<std::vector<int> > candidates;
+    double unassignedCost = 0;
+    double impossibleCost = 0;
+};
+
+// Problems in a simple text format ("rows cols" followed by the costs in row order, then the unassigned and impossible
+// costs, the marginal costs of every column and the candidates of every row, each list prefixed by its length),
+// used to record the problems the bot solves so that the solvers can be compared on them with lapbench.
+// Files that end after the costs are read as unit capacity problems without candidates.
+// Return false if the file could not be opened or parsed.
+bool writeMatchingProblem(const std::string& path, const MatchingProblem& problem);
+bool readMatchingProblem(const std::string& path, MatchingProblem& problem);
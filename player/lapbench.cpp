@@ -0,0 +1,313 @@
+// Benchmark of the assignment solvers, not part of the bot.
+//
+//   g++ -std=c++11 -O2 lapbench.cpp lap.cpp hungarian.cpp -o lapbench
+//   ./lapbench [problem files...]
+//
+// Problems can be recorded by running a debug build of the bot with LAP_RECORD_DIR set (see matchWorkers).
+// Without arguments random problems shaped like the worker matching ones are used: karbonite groups that take
+// up to 3 workers and damaged structures that take up to 8, with diminishing returns, some unreachable targets,
+// and the candidates picked from an upper bound on the score like selectMatchingCandidates does.
+//
+// Every problem is solved twice:
+// - As a plain assignment problem over the costs alone (one worker per target), to compare the dense solvers.
+// - As the capacitated problem the bot solves. The reference is the shortest path solve of the expanded problem,
+//   which has one column per slot of a target and one per worker for staying unassigned. solveSparse over all pairs
+//   should match it exactly. solveSparse over the candidates the bot picked shows how much the pruning loses.
+//   The warm column solves the problem over all pairs, changes it like the next turn would (a worker and a target
+//   go away, a worker is added, the costs change a little) and compares the warm started solve of the new problem
+//   with a cold one. The cost difference should be 0.
+
+#include "lap.h"
+#include "hungarian.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+// Same as in matchWorkers
+static const double INF = 1000000;
+static const int BOT_CANDIDATES[] = { 12, 4 };
+
+static MatchingProblem randomProblem(int workers, int groups, int numCandidates, mt19937& rng) {
+    uniform_real_distribution<double> unit(0, 1);
+    int structures = groups / 10;
+    int targets = groups + structures;
+    vector<pair<double, double> > targetPositions(targets);
+    for (auto& p : targetPositions) p = make_pair(unit(rng) * 50, unit(rng) * 50);
+
+    // The bound is the value divided by the number of steps to the target, the score uses the length of the path
+    vector<vector<double> > scores(workers, vector<double>(targets));
+    vector<vector<double> > bounds(workers, vector<double>(targets));
+    for (int i = 0; i < workers; i++) {
+        double x = unit(rng) * 50;
+        double y = unit(rng) * 50;
+        for (int t = 0; t < targets; t++) {
+            if (unit(rng) < 0.05) {
+                scores[i][t] = -INF;
+                bounds[i][t] = -1;
+                continue;
+            }
+            double dx = fabs(targetPositions[t].first - x);
+            double dy = fabs(targetPositions[t].second - y);
+            double value = 1 + unit(rng);
+            double distance = hypot(dx, dy) * (1 + 0.5 * unit(rng));
+            scores[i][t] = value / (1 + distance);
+            bounds[i][t] = value / (1 + max(dx, dy));
+        }
+    }
+
+    // Same marginal costs as matchWorkers, the groups as in its first iteration
+    MatchingProblem problem;
+    problem.marginalCosts.resize(targets);
+    double mx = 0;
+    for (int t = 0; t < targets; t++) {
+        double bestScore = 0;
+        for (int i = 0; i < workers; i++) bestScore = max(bestScore, scores[i][t]);
+        mx = max(mx, bestScore);
+
+        vector<double> factors;
+        if (t < groups) {
+            for (int k = 0; k < 3; k++) factors.push_back(1.0 / (k + 1));
+        } else {
+            int capacity = 1 + (int)(unit(rng) * 8);
+            for (int k = 0; k < capacity; k++) factors.push_back(1 - k / (double)capacity);
+        }
+        for (double factor : factors) problem.marginalCosts[t].push_back(bestScore * (1 - factor));
+    }
+
+    problem.costs = scores;
+    for (auto& row : problem.costs) {
+        for (auto& v : row) v = mx - v;
+    }
+    problem.unassignedCost = INF + 2 * mx;
+    problem.impossibleCost = INF;
+    problem.candidates = selectCandidates(bounds, numCandidates);
+    return problem;
+}
+
+// Input of solveSparse
+struct SparseProblem {
+    vector<vector<pair<int, double> > > candidates;
+    vector<vector<double> > marginalCosts;
+    vector<int64_t> rowKeys;
+    vector<int64_t> colKeys;
+    double unassignedCost;
+};
+
+// Every possible pair is a candidate if allPairs is set, otherwise only the candidates of the problem
+static SparseProblem sparseProblem(const MatchingProblem& problem, bool allPairs) {
+    int n = problem.costs.size();
+    int m = problem.marginalCosts.size();
+    SparseProblem sparse;
+    sparse.marginalCosts = problem.marginalCosts;
+    sparse.unassignedCost = problem.unassignedCost;
+    for (int i = 0; i < n; i++) sparse.rowKeys.push_back(i);
+    for (int j = 0; j < m; j++) sparse.colKeys.push_back(j);
+    sparse.candidates.resize(n);
+    for (int i = 0; i < n; i++) {
+        auto add = [&](int j) {
+            if (problem.costs[i][j] < problem.impossibleCost) sparse.candidates[i].push_back(make_pair(j, problem.costs[i][j]));
+        };
+        if (allPairs) {
+            for (int j = 0; j < m; j++) add(j);
+        } else {
+            for (int j : problem.candidates[i]) add(j);
+        }
+    }
+    return sparse;
+}
+
+// The problem one turn later: the first row and the last column are removed, a copy of the second row is added
+// and every cost changes by a few percent
+static SparseProblem nextTurn(const SparseProblem& problem, mt19937& rng) {
+    normal_distribution<double> change(0, 0.03);
+    int n = problem.candidates.size();
+    int m = problem.colKeys.size();
+    SparseProblem next = problem;
+    next.marginalCosts.pop_back();
+    next.colKeys.pop_back();
+    next.candidates.erase(next.candidates.begin());
+    next.rowKeys.erase(next.rowKeys.begin());
+    if (n > 1) {
+        next.candidates.push_back(problem.candidates[1]);
+        next.rowKeys.push_back(n);
+    }
+    for (auto& row : next.candidates) {
+        row.erase(remove_if(row.begin(), row.end(), [&](const pair<int, double>& c) { return c.first >= m - 1; }), row.end());
+        for (auto& c : row) c.second *= 1 + change(rng);
+    }
+    return next;
+}
+
+// Total cost of an assignment in the capacitated problem. Rows without a column or with an impossible pair cost
+// unassignedCost, the k-th row at a column adds its k-th marginal cost. NAN if a column takes too many rows.
+static double capacitatedCost(const MatchingProblem& problem, const vector<int>& assignment) {
+    vector<int> load(problem.marginalCosts.size());
+    double total = 0;
+    for (int i = 0; i < (int)assignment.size(); i++) {
+        int j = assignment[i];
+        if (j == -1 || problem.costs[i][j] >= problem.impossibleCost) {
+            total += problem.unassignedCost;
+            continue;
+        }
+        if (load[j] >= (int)problem.marginalCosts[j].size()) return NAN;
+        total += problem.costs[i][j] + problem.marginalCosts[j][load[j]++];
+    }
+    return total;
+}
+
+// Solves the capacitated problem exactly with the dense solver. Every target gets one column per slot
+// and every row a private column for staying unassigned. Pairs that cannot be used cost more than
+// staying unassigned, so they are never chosen.
+static double expandedSolve(LapSolver& lap, const MatchingProblem& problem, vector<int>& assignment) {
+    int n = problem.costs.size();
+    vector<int> slotColumn;
+    vector<double> slotCost;
+    for (int j = 0; j < (int)problem.marginalCosts.size(); j++) {
+        for (double c : problem.marginalCosts[j]) {
+            slotColumn.push_back(j);
+            slotCost.push_back(c);
+        }
+    }
+    int numSlots = slotColumn.size();
+    double unusable = 4 * fabs(problem.unassignedCost) + 1;
+    vector<vector<double> > expanded(n, vector<double>(numSlots + n, unusable));
+    for (int i = 0; i < n; i++) {
+        for (int s = 0; s < numSlots; s++) {
+            double c = problem.costs[i][slotColumn[s]];
+            if (c < problem.impossibleCost) expanded[i][s] = c + slotCost[s];
+        }
+        expanded[i][numSlots + i] = problem.unassignedCost;
+    }
+    vector<int> slotAssignment;
+    lap.solve(expanded, slotAssignment);
+    assignment.assign(n, -1);
+    for (int i = 0; i < n; i++) {
+        if (slotAssignment[i] != -1 && slotAssignment[i] < numSlots) assignment[i] = slotColumn[slotAssignment[i]];
+    }
+    return capacitatedCost(problem, assignment);
+}
+
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+struct Result {
+    double cost;
+    double ms;
+};
+
+static Result run(const function<double(vector<int>&)>& solver, int repetitions) {
+    vector<int> assignment;
+    double cost = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        cost = solver(assignment);
+    }
+    return { cost, millisSince(start) / repetitions };
+}
+
+static void printResults(const string& name, const MatchingProblem& problem, const string& kind, const vector<Result>& results, double optimal) {
+    int n = problem.costs.size();
+    printf("%-44s %4dx%-4d %-12s", name.c_str(), n, n == 0 ? 0 : (int)problem.costs[0].size(), kind.c_str());
+    for (auto result : results) {
+        printf("  %9.3f ms %+11.4f", result.ms, result.cost - optimal);
+    }
+}
+
+static void benchmark(const string& name, const MatchingProblem& problem) {
+    LapSolver lap;
+    HungarianAlgorithm hungarian;
+    int repetitions = problem.costs.size() < 30 ? 20 : 3;
+
+    // One worker per target, the costs alone
+    auto costs = problem.costs;
+    auto shortestPath = run([&](vector<int>& a) { return lap.solve(costs, a); }, repetitions);
+    auto auction = run([&](vector<int>& a) { return lap.solve(costs, a, LapSolver::Method::Auction); }, repetitions);
+    auto greedy = run([&](vector<int>& a) { return greedyWeightedMatching(costs, a); }, repetitions);
+    Result munkres = { NAN, NAN };
+    // The Munkres implementation gets very slow for large matrices
+    if (costs.size() <= 100) {
+        munkres = run([&](vector<int>& a) { return hungarian.Solve(costs, a); }, 1);
+    }
+    printResults(name, problem, "assignment", { shortestPath, auction, greedy, munkres }, shortestPath.cost);
+    printf("\n");
+
+    // The capacitated problem
+    auto expanded = run([&](vector<int>& a) { return expandedSolve(lap, problem, a); }, repetitions);
+    auto greedyCapacitated = run([&](vector<int>& a) {
+        greedyCapacitatedMatching(problem.costs, problem.marginalCosts, a);
+        return capacitatedCost(problem, a);
+    }, repetitions);
+    Result sparse[2] = { { NAN, NAN }, { NAN, NAN } };
+    for (int k = 0; k < 2; k++) {
+        bool allPairs = k == 0;
+        if (!allPairs && problem.candidates.empty()) continue;
+        auto sparseInput = sparseProblem(problem, allPairs);
+        sparse[k] = run([&](vector<int>& a) {
+            // A new solver every time, otherwise the later repetitions would be warm started
+            LapSolver sparseSolver;
+            sparseSolver.solveSparse(sparseInput.candidates, sparseInput.marginalCosts, sparseInput.rowKeys, sparseInput.colKeys, sparseInput.unassignedCost, a);
+            return capacitatedCost(problem, a);
+        }, repetitions);
+    }
+
+    // Warm started solve of the next turn compared with a cold one
+    Result warm = { NAN, NAN };
+    int warmAugmentations = 0;
+    int coldAugmentations = 0;
+    if (problem.marginalCosts.size() > 1) {
+        mt19937 rng(problem.costs.size());
+        auto first = sparseProblem(problem, true);
+        auto next = nextTurn(first, rng);
+        vector<int> assignment;
+        LapSolver warmSolver;
+        warmSolver.solveSparse(first.candidates, first.marginalCosts, first.rowKeys, first.colKeys, first.unassignedCost, assignment);
+        auto start = chrono::steady_clock::now();
+        double warmCost = warmSolver.solveSparse(next.candidates, next.marginalCosts, next.rowKeys, next.colKeys, next.unassignedCost, assignment);
+        double warmMs = millisSince(start);
+        warmAugmentations = warmSolver.augmentations;
+        LapSolver coldSolver;
+        double coldCost = coldSolver.solveSparse(next.candidates, next.marginalCosts, next.rowKeys, next.colKeys, next.unassignedCost, assignment);
+        coldAugmentations = coldSolver.augmentations;
+        warm = { warmCost - coldCost, warmMs };
+    }
+    printResults("", problem, "capacitated", { expanded, greedyCapacitated, sparse[0], sparse[1] }, expanded.cost);
+    printf("  %9.3f ms %+11.4f %4d/%-4d\n", warm.ms, warm.cost, warmAugmentations, coldAugmentations);
+}
+
+int main(int argc, char** argv) {
+    printf("%-44s %9s %-12s  %26s  %26s  %26s  %26s\n", "problem", "size", "assignment", "shortest path", "auction", "greedy", "munkres");
+    printf("%-44s %9s %-12s  %26s  %26s  %26s  %26s  %36s\n", "", "", "capacitated", "expanded shortest path", "greedy", "sparse, all pairs", "sparse, bot candidates", "warm");
+    printf("%-44s %9s %-12s  %26s  %26s  %26s  %26s  %36s\n", "", "", "", "time / cost vs first", "", "", "", "time / cost vs cold / augmentations");
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            MatchingProblem problem;
+            if (!readMatchingProblem(argv[i], problem)) {
+                fprintf(stderr, "Could not read %s\n", argv[i]);
+                continue;
+            }
+            if (problem.costs.empty() || problem.costs[0].empty()) continue;
+            benchmark(argv[i], problem);
+        }
+        return 0;
+    }
+
+    mt19937 rng(123);
+    for (int workers : { 10, 30, 60, 100, 150 }) {
+        for (int groups : { 20, 60, 150 }) {
+            for (int numCandidates : BOT_CANDIDATES) {
+                auto problem = randomProblem(workers, groups, numCandidates, rng);
+                benchmark("random " + to_string(workers) + " workers " + to_string(groups) + " groups " + to_string(numCandidates) + " cand.", problem);
+            }
+        }
+    }
+}
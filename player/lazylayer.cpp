@@ -0,0 +1,61 @@
+#include "lazylayer.h"
+
+using namespace std;
+
+LayerSource ourUnitsSource("our units");
+LayerSource enemyUnitsSource("enemy units");
+
+static vector<LazyLayer*>& allLazyLayers() {
+    static vector<LazyLayer*> layers;
+    return layers;
+}
+
+LazyLayer::LazyLayer(const char* name, vector<LayerSource*> inputs, function<void(PathfindingMap&)> compute)
+    : LayerSource(name), inputs(inputs), inputVersions(inputs.size(), -1), compute(compute) {
+    allLazyLayers().push_back(this);
+}
+
+void LazyLayer::refresh() {
+    bool upToDate = computed;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputs[i]->refresh();
+        if (inputs[i]->version != inputVersions[i]) {
+            upToDate = false;
+        }
+    }
+    if (upToDate) {
+        return;
+    }
+
+    map = PathfindingMap(w, h);
+    compute(map);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputVersions[i] = inputs[i]->version;
+    }
+    computed = true;
+    materializations++;
+    invalidate();
+}
+
+const PathfindingMap& LazyLayer::get() {
+    refresh();
+    return map;
+}
+
+void resetLazyLayerStats() {
+    for (auto layer : allLazyLayers()) {
+        layer->materializations = 0;
+    }
+}
+
+void printLazyLayerStats() {
+    int materialized = 0;
+    cout << "Lazy layers computed:";
+    for (auto layer : allLazyLayers()) {
+        if (layer->materializations > 0) {
+            cout << " " << layer->name << " (" << layer->materializations << ")";
+            materialized++;
+        }
+    }
+    cout << " [" << materialized << "/" << allLazyLayers().size() << "]" << endl;
+}
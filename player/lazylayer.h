@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "common.h"
+#include "pathfinding.hpp"
+
+// Something that map layers can be computed from.
+// Calling invalidate drops every layer that was built from it.
+struct LayerSource {
+    const char* name;
+    int version = 0;
+
+    explicit LayerSource(const char* name) : name(name) {}
+    virtual ~LayerSource() {}
+
+    void invalidate() { version++; }
+    // Make sure the data is up to date
+    virtual void refresh() {}
+};
+
+// Map layer which is computed the first time it is read after one of its inputs has changed.
+// Layers that nothing reads during a turn are never computed.
+// A layer is itself a source, so layers can be built from other layers.
+struct LazyLayer : LayerSource {
+    LazyLayer(const char* name, std::vector<LayerSource*> inputs, std::function<void(PathfindingMap&)> compute);
+
+    const PathfindingMap& get();
+    void refresh() override;
+
+    // Number of times the layer has been computed since the last call to resetLazyLayerStats
+    int materializations = 0;
+
+private:
+    std::vector<LayerSource*> inputs;
+    std::vector<int> inputVersions;
+    std::function<void(PathfindingMap&)> compute;
+    PathfindingMap map;
+    bool computed = false;
+};
+
+// Invalidated by findUnits
+extern LayerSource ourUnitsSource;
+extern LayerSource enemyUnitsSource;
+
+void resetLazyLayerStats();
+// Prints which layers were computed since the last reset
+void printLazyLayerStats();
@@ -16,6 +16,15 @@
 #include "rocket.h"
 #include "worker.h"
 #include "maps.h"
+#include "vision.h"
+#include "gamecache.h"
+#include "karbonite.h"
+#include "staticmaps.h"
+#include "unitinfo.h"
+#include "parallel.h"
+#include "scheduler.h"
+#include "timebudget.h"
+#include "timemapcache.h"
 
 using namespace bc;
 using namespace std;
@@ -111,16 +120,15 @@ vector<Unit*> getUnitsInDisk(MapLocation center, int squaredRadius) {
     int y = center.get_y();
     vector<Unit*> ret;
     for (int dx = -r; dx <= r; ++dx) {
-        for (int dy = -r; dy <= r; ++dy) {
-            int dis2 = dx * dx + dy * dy;
-            if (dis2 > squaredRadius)
-                continue;
-            int nx = x + dx;
-            int ny = y + dy;
-            if (nx < 0 || ny < 0 || nx >= w || ny >= h)
-                continue;
-            if (unitAtLocation[nx][ny] != nullptr)
-                ret.push_back(unitAtLocation[nx][ny]);
+        int nx = x + dx;
+        if (nx < 0 || nx >= w)
+            continue;
+        int k = floor(sqrt(squaredRadius - dx * dx));
+        uint64_t column = unitOccupancy.bits[nx] & Bitboard::rangeMask(y - k, y + k);
+        while (column != 0) {
+            int ny = __builtin_ctzll(column);
+            column &= column - 1;
+            ret.push_back(unitAtLocation[nx][ny]);
         }
     }
     return ret;
@@ -198,7 +206,7 @@ struct BotHealer : BotUnit {
                 }
             }*/
             if (hasOvercharge) {
-                targetMap += healerOverchargeMap * 10;
+                targetMap += healerOverchargeLayer.get() * 10;
             }
             targetMap /= (enemyInfluenceMap * 10.0 + stuckUnitMap + 1.0);
             targetMap /= rocketHazardMap + 0.1;
@@ -298,8 +306,7 @@ struct BotHealer : BotUnit {
             }
             if (bestTargetId != -1) {
                 gc.heal(id, bestTargetId);
-                invalidate_unit(bestTargetId);
-                invalidate_unit(id);
+                onHeal(id, bestTargetId);
                 return true;
             }
         }
@@ -317,7 +324,7 @@ struct BotHealer : BotUnit {
 
         succeededHealing = healUnits();
 
-        if (veryLowTimeRemaining) {
+        if (veryLowTimeRemaining || turnPreempted("movement")) {
             return;
         }
 
@@ -356,8 +363,7 @@ struct BotHealer : BotUnit {
             if (best_unit != nullptr) {
                 int otherUnitId = best_unit->get_id();
                 gc.overcharge(unit.get_id(), best_unit->get_id());
-                invalidate_unit(best_unit->get_id());
-                invalidate_unit(id);
+                onOvercharge(id, otherUnitId);
                 unitMap[otherUnitId]->tick();
             }
         }
@@ -385,7 +391,7 @@ struct BotFactory : BotUnit {
         if (!unit.is_factory_producing()) {
             const auto& location = unit.get_location().get_map_location();
             double nearbyEnemiesWeight = enemyNearbyMap.weights[location.get_x()][location.get_y()];
-            auto researchInfo = gc.get_research_info();
+            const auto& researchInfo = gameCache.researchInfo();
             if (existsPathToEnemy){
                 double score = 1;
                 if (distanceToInitialLocation[enemyTeam].weights[location.get_x()][location.get_y()] < 14 && gc.get_round() < 80)
@@ -509,11 +515,11 @@ void selectTravellersForRocket(Unit& unit) {
     bool hasWorker = false;
     int hasHealers = 0;
     for (auto id : unit.get_structure_garrison()) {
-        auto u = gc.get_unit(id);
-        if (u.get_unit_type() == Worker) {
+        auto type = gameCache.unitType(id);
+        if (type == Worker) {
             hasWorker = true;
         }
-        if (u.get_unit_type() == Healer) {
+        if (type == Healer) {
             ++hasHealers;
         }
     }
@@ -548,7 +554,7 @@ void selectTravellersForRocket(Unit& unit) {
     }
     sort(candidates.begin(), candidates.end());
     for (int i = 0; i < min((int) candidates.size(), remainingTravellers); i++) {
-        auto unitType = gc.get_unit(candidates[i].second).get_unit_type();
+        auto unitType = gameCache.unitType(candidates[i].second);
         if (unitType == Worker) {
             if (hasWorker && launchedWorkerCount) {
                 ++remainingTravellers;
@@ -571,7 +577,7 @@ struct Researcher {
     UnitType getBestResearch() {
         map<UnitType, double> scores;
 
-        auto researchInfo = gc.get_research_info();
+        const auto& researchInfo = gameCache.researchInfo();
         switch(researchInfo.get_level(Knight)) {
             case 0:
                 scores[Knight] = 2 + 0.1 * state.typeCount[Knight];
@@ -704,6 +710,7 @@ struct Researcher {
 
 void findUnits() {
     unitAtLocation = vector<vector<Unit*> >(w, vector<Unit*>(h, nullptr));
+    unitOccupancy.clear();
     ourUnits = gc.get_my_units();
     sort(ourUnits.begin(), ourUnits.end(), [](const Unit& a, const Unit& b) -> bool
     { 
@@ -737,15 +744,20 @@ void findUnits() {
         if (unit.get_location().is_on_map()) {
             const auto location = unit.get_location().get_map_location();
             unitAtLocation[location.get_x()][location.get_y()] = &unit;
+            unitOccupancy.set(location.get_x(), location.get_y());
         }
     }
     for (auto& unit : enemyUnits)
         allUnits.push_back(unit.clone());
+    buildUnitInfos();
+    ourUnitsSource.invalidate();
+    enemyUnitsSource.invalidate();
+    unitsCreated = false;
 }
 
 void updateEnemyHasRangers() {
     double newEstimate = 0;
-    for (auto& u : enemyUnits) {
+    for (auto& u : enemyUnitInfos) {
         if (u.get_unit_type() == Ranger) {
             enemyHasRangers = true;
             ++newEstimate;
@@ -758,7 +770,7 @@ void updateEnemyHasRangers() {
 void updateEnemyHasMages() {
     if (enemyHasMages)
         return;
-    for (auto& u : enemyUnits) {
+    for (auto& u : enemyUnitInfos) {
         if (u.get_unit_type() == Mage)
             enemyHasMages = true;
     }
@@ -766,7 +778,7 @@ void updateEnemyHasMages() {
 
 void updateEnemyHasKnights() {
     double newEstimate = 0;
-    for (auto& u : enemyUnits) {
+    for (auto& u : enemyUnitInfos) {
         if (u.get_unit_type() == Knight) {
             enemyHasKnights = true;
             ++newEstimate;            
@@ -778,11 +790,13 @@ void updateEnemyHasKnights() {
 
 void updateAsteroids() {
     if (gc.get_planet() == Mars) {
-        auto asteroidPattern = gc.get_asteroid_pattern();
+        auto& asteroidPattern = gameCache.asteroidPattern();
         if (asteroidPattern.has_asteroid_on_round(gc.get_round())) {
             auto strike = asteroidPattern.get_asteroid_on_round(gc.get_round());
             auto location = strike.get_map_location();
-            karboniteMap.weights[location.get_x()][location.get_y()] += strike.get_karbonite();
+            int x = location.get_x();
+            int y = location.get_y();
+            karboniteIndex.set(x, y, karboniteMap.weights[x][y] + strike.get_karbonite());
         }
     }
 }
@@ -836,42 +850,21 @@ void updateEnemyPositionMap() {
 void updateNearbyFriendMap() {
     nearbyFriendMap = PathfindingMap(w, h);
 
-    for (auto& u : ourUnits) {
+    for (auto& u : ourUnitInfos) {
         if (u.get_unit_type() == Ranger) {
-            if (!u.get_location().is_on_map()) {
-                continue;
-            }
-            auto pos = u.get_location().get_map_location();
-            nearbyFriendMap.addInfluence(rangerProximityInfluence, pos.get_x(), pos.get_y());
+            nearbyFriendMap.addInfluence(rangerProximityInfluence, u.get_x(), u.get_y());
         }
     }
 }
 
 void initKarboniteMap() {
-    karboniteMap = PathfindingMap(w, h);
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            auto location = MapLocation(gc.get_planet(), i, j);
-            int karbonite = planetMap->get_initial_karbonite_at(location);
-            karboniteMap.weights[i][j] = karbonite;
-        }
-    }
-}
-
-void updateCanSenseLocation() {
-    canSenseLocation = vector<vector<bool>>(w, vector<bool>(h));
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            auto location = MapLocation(gc.get_planet(), i, j);
-            canSenseLocation[i][j] = gc.can_sense_location(location);
-        }
-    }
+    karboniteIndex.init();
 }
 
 void updateDiscoveryMap() {
     for (int i = 0; i < w; i++) {
         for (int j = 0; j < h; j++) {
-            if (canSenseLocation[i][j]) {
+            if (canSenseLocation.test(i, j)) {
                 discoveryMap.weights[i][j] = 0.0;
             }
             else {
@@ -881,74 +874,31 @@ void updateDiscoveryMap() {
     }
 }
 
-void computeDistancesToInitialLocations() {
-    assert(planet == Earth);
-    auto&& initial_units = gc.get_starting_planet(Earth).get_initial_units();
-    for (int team = 0; team < 2; ++team) {
-        distanceToInitialLocation[team] = PathfindingMap(w, h);
-        distanceToInitialLocation[team] += 1000;
-        queue<pair<int, int> > bfsQueue;
-        for (auto& unit : initial_units) {
-            if (!unit.get_location().is_on_map())
-                continue;
-            if (unit.get_team() == team) {
-                auto pos = unit.get_location().get_map_location();
-                int x = pos.get_x();
-                int y = pos.get_y();
-                distanceToInitialLocation[team].weights[x][y] = 0;
-                bfsQueue.push(make_pair(x, y));
-
-            }
-        }
-        while(!bfsQueue.empty()) {
-            auto cur = bfsQueue.front();
-            bfsQueue.pop();
-            int x = cur.first;
-            int y = cur.second;
-            if (team == 1) {
-                initialDistanceToEnemyLocation = min(initialDistanceToEnemyLocation, (int)(distanceToInitialLocation[0].weights[x][y] + distanceToInitialLocation[1].weights[x][y]));
-            }
-            for (int dx = -1; dx <= 1; dx++) {
-                for (int dy = -1; dy <= 1; dy++) {
-                    int nx = x + dx;
-                    int ny = y + dy;
-                    if (nx < 0 || ny < 0 || nx >= w || ny >= h)
-                        continue;
-                    if (passableMap.weights[nx][ny] > 1000)
-                        continue;
-                    int newDis = distanceToInitialLocation[team].weights[x][y] + 1;
-                    if (newDis < distanceToInitialLocation[team].weights[nx][ny]) {
-                        distanceToInitialLocation[team].weights[nx][ny] = newDis;
-                        bfsQueue.push(make_pair(nx, ny));
-                    }
-                }
-            }
-        }
-    }
-}
-
 // NOTE: this call also updates enemy position map for some reason
 void updateKarboniteMap() {
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            if (canSenseLocation[i][j]) {
-                if (karboniteMap.weights[i][j]) {
-                    const MapLocation location(planet, i, j);
-                    int karbonite = gc.get_karbonite_at(location);
-                    karboniteMap.weights[i][j] = karbonite;
-                    if (planet == Earth && distanceToInitialLocation[ourTeam].weights[i][j] > 200) {
-                        // The karbonite is pretty much unreachable, so let's ignore it
-                        karboniteMap.weights[i][j] = 0.01;
-                    }
-                }
-                enemyPositionMap.weights[i][j] = 0;
+    // Iterate backwards since tiles that are mined out are swapped with the last tile and removed
+    for (int index = (int)karboniteIndex.tiles.size() - 1; index >= 0; index--) {
+        int i = karboniteIndex.tiles[index].first;
+        int j = karboniteIndex.tiles[index].second;
+        if (canSenseLocation.test(i, j)) {
+            const MapLocation location(planet, i, j);
+            double karbonite = gc.get_karbonite_at(location);
+            if (planet == Earth && distanceToInitialLocation[ourTeam].weights[i][j] > 200) {
+                // The karbonite is pretty much unreachable, so let's ignore it.
+                // This keeps the tile in the index even when it is mined out, like it always was.
+                karbonite = 0.01;
             }
+            karboniteIndex.set(i, j, karbonite);
         }
     }
+
+    canSenseLocation.forEach([](int x, int y) {
+        enemyPositionMap.weights[x][y] = 0;
+    });
 }
 
 void updateFuzzyKarboniteMap() {
-    contestedKarbonite = 0;
+    contestedKarbonite = karboniteIndex.contested;
     fuzzyKarboniteMap = PathfindingMap(w, h);
     for (int i = 0; i < w; i++) {
         for (int j = 0; j < h; j++) {
@@ -970,11 +920,6 @@ void updateFuzzyKarboniteMap() {
                 int disDiff = distanceToInitialLocation[enemyTeam].weights[i][j] - distanceToInitialLocation[ourTeam].weights[i][j];
                 // 0 when karbonite is very close to us, 1 when close to enemy, 0.5 when equally close
                 float relativeDiff = distanceToInitialLocation[ourTeam].weights[i][j] / (distanceToInitialLocation[enemyTeam].weights[i][j] + distanceToInitialLocation[ourTeam].weights[i][j]);
-                if (disDiff <= 4 && disDiff >= -4) {
-                    contestedKarbonite += karboniteMap.weights[i][j];
-                } else if (disDiff <= 5 && disDiff >= -5) {
-                    contestedKarbonite += karboniteMap.weights[i][j] * 0.5f;
-                }
 
                 if (disDiff <= 6) {
                     karbs *= 1.2;
@@ -999,118 +944,90 @@ void updateFuzzyKarboniteMap() {
     fuzzyKarboniteMap /= ourStartingPositionMap;
 }
 
+// Read by the mage target map and the ranger and mage cost maps (knights use their own knight influence).
+// Computed once per turn on the first of these, so turns without rangers or mages do not pay for it.
+LazyLayer enemyKnightNearbyLayer("enemyKnightNearbyMap", { &enemyUnitsSource }, [](PathfindingMap& enemyKnightNearbyMap) {
+    for (auto& u : enemyUnitInfos) {
+        if (u.get_unit_type() == Knight) {
+            enemyKnightNearbyMap.addInfluenceMultiple(mageHideFromKnightInfluence, u.get_x(), u.get_y(), 3.0);
+        }
+    }
+});
+
+// Only read by healers once we have overcharge
+LazyLayer healerOverchargeLayer("healerOverchargeMap", { &enemyUnitsSource }, [](PathfindingMap& healerOverchargeMap) {
+    for (auto& u : enemyUnitInfos) {
+        healerOverchargeMap.maxInfluence(healerOverchargeInfluence, u.get_x(), u.get_y());
+    }
+});
+
+// Only read by mages
+LazyLayer mageNearbyFuzzyLayer("mageNearbyFuzzyMap", { &ourUnitsSource }, [](PathfindingMap& mageNearbyFuzzyMap) {
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Mage) {
+            mageNearbyFuzzyMap.maxInfluence(mageNearbyFuzzyInfluence, u.get_x(), u.get_y());
+        }
+    }
+});
+
 void updateEnemyInfluenceMaps(){
     enemyInfluenceMap = PathfindingMap(w, h);
     enemyNearbyMap = PathfindingMap(w, h);
     enemyFactoryNearbyMap = PathfindingMap(w, h);
-    healerOverchargeMap = PathfindingMap(w, h);
-    enemyExactPositionMap = PathfindingMap(w, h);
+    enemyExactPositions.clear();
     rangerCanShootEnemyCountMap = PathfindingMap(w, h);
-    enemyKnightNearbyMap = PathfindingMap(w, h);
-    for (auto& u : enemyUnits) {
-        if (u.get_location().is_on_map()) {
-            auto pos = u.get_location().get_map_location();
-            if (u.get_unit_type() == Ranger) {
-                enemyInfluenceMap.addInfluence(enemyRangerTargetInfluence, pos.get_x(), pos.get_y());
-            }
-            if (u.get_unit_type() == Mage) {
-                enemyInfluenceMap.addInfluenceMultiple(enemyMageTargetInfluence, pos.get_x(), pos.get_y(), 2.0);
-            }
-            if (u.get_unit_type() == Knight) {
-                enemyInfluenceMap.addInfluenceMultiple(enemyKnightTargetInfluence, pos.get_x(), pos.get_y(), 3.0);
-                enemyKnightNearbyMap.addInfluenceMultiple(mageHideFromKnightInfluence, pos.get_x(), pos.get_y(), 3.0);
-            }
-            if (u.get_unit_type() == Factory) {
-				enemyFactoryNearbyMap.maxInfluence(enemyFactoryNearbyInfluence, pos.get_x(), pos.get_y());
-			}
-			if (u.get_unit_type() != Worker) {
-                enemyNearbyMap.maxInfluence(wideEnemyInfluence, pos.get_x(), pos.get_y());
-            }
-            rangerCanShootEnemyCountMap.addInfluence(rangerTargetInfluence, pos.get_x(), pos.get_y());
-            enemyPositionMap.weights[pos.get_x()][pos.get_y()] += 1.0;
-            enemyExactPositionMap.weights[pos.get_x()][pos.get_y()] = 1;
-            healerOverchargeMap.maxInfluence(healerOverchargeInfluence, pos.get_x(), pos.get_y());
+    for (auto& u : enemyUnitInfos) {
+        if (u.get_unit_type() == Ranger) {
+            enemyInfluenceMap.addInfluence(enemyRangerTargetInfluence, u.get_x(), u.get_y());
         }
-    }
-
-    if (planet == Earth) {
-        auto&& initial_units = gc.get_starting_planet(Earth).get_initial_units();
-        for (auto& unit : initial_units) {
-            if (!unit.get_location().is_on_map())
-                continue;
-            if (unit.get_team() == enemyTeam) {
-                auto pos = unit.get_location().get_map_location();
-                for (int x = 0; x < w; ++x) {
-                    for (int y = 0; y < h; ++y) {
-                        int dx = pos.get_x() - x;
-                        int dy = pos.get_y() - y;
-                        enemyNearbyMap.weights[x][y] += 0.01 / (dx * dx + dy * dy + 5);
-                    }
-                }
-            }
+        if (u.get_unit_type() == Mage) {
+            enemyInfluenceMap.addInfluenceMultiple(enemyMageTargetInfluence, u.get_x(), u.get_y(), 2.0);
         }
+        if (u.get_unit_type() == Knight) {
+            enemyInfluenceMap.addInfluenceMultiple(enemyKnightTargetInfluence, u.get_x(), u.get_y(), 3.0);
+        }
+        if (u.get_unit_type() == Factory) {
+            enemyFactoryNearbyMap.maxInfluence(enemyFactoryNearbyInfluence, u.get_x(), u.get_y());
+        }
+        if (u.get_unit_type() != Worker) {
+            enemyNearbyMap.maxInfluence(wideEnemyInfluence, u.get_x(), u.get_y());
+        }
+        rangerCanShootEnemyCountMap.addInfluence(rangerTargetInfluence, u.get_x(), u.get_y());
+        enemyPositionMap.weights[u.get_x()][u.get_y()] += 1.0;
+        enemyExactPositions.set(u.get_x(), u.get_y());
     }
-}
 
-void computeOurStartingPositionMap() {
-    ourStartingPositionMap = PathfindingMap(w, h);
     if (planet == Earth) {
-        auto&& initial_units = gc.get_starting_planet(Earth).get_initial_units();
-        for (auto& unit : initial_units) {
-            if (!unit.get_location().is_on_map())
-                continue;
-            if (unit.get_team() == ourTeam) {
-                auto pos = unit.get_location().get_map_location();
-                for (int x = 0; x < w; ++x) {
-                    for (int y = 0; y < h; ++y) {
-                        int dx = pos.get_x() - x;
-                        int dy = pos.get_y() - y;
-                        ourStartingPositionMap.weights[x][y] = max(ourStartingPositionMap.weights[x][y], 200.0 / (dx * dx + dy * dy + 200.0));
-                    }
-                }
-            }
-        }
-    }
-    else {
-        ourStartingPositionMap += 1;
+        enemyNearbyMap += initialEnemyProximityMap;
     }
 }
 
 void updateWorkerMaps() {
     workerProximityMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_location().is_on_map()) {
-            if (u.get_unit_type() == Worker) {
-                auto pos = u.get_location().get_map_location();
-                workerProximityMap.maxInfluence(workerProximityInfluence, pos.get_x(), pos.get_y());
-            }
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Worker) {
+            workerProximityMap.maxInfluence(workerProximityInfluence, u.get_x(), u.get_y());
         }
     }
 
     workerAdditiveMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_location().is_on_map()) {
-            if (u.get_unit_type() == Worker) {
-                auto pos = u.get_location().get_map_location();
-                workerAdditiveMap.addInfluence(workerAdditiveInfluence, pos.get_x(), pos.get_y());
-            }
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Worker) {
+            workerAdditiveMap.addInfluence(workerAdditiveInfluence, u.get_x(), u.get_y());
         }
     }
 
     workersNextToMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_location().is_on_map()) {
-            if (u.get_unit_type() == Worker) {
-                auto pos = u.get_location().get_map_location();
-                int x = pos.get_x();
-                int y = pos.get_y();
-                for (int dx = -1; dx <= 1; ++dx) {
-                    for (int dy = -1; dy <= 1; ++dy) {
-                        int nx = x + dx;
-                        int ny = y + dy;
-                        if (nx >= 0 && ny >= 0 && nx < w && ny < h) {
-                            workersNextToMap.weights[nx][ny]++;
-                        }
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Worker) {
+            int x = u.get_x();
+            int y = u.get_y();
+            for (int dx = -1; dx <= 1; ++dx) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if (nx >= 0 && ny >= 0 && nx < w && ny < h) {
+                        workersNextToMap.weights[nx][ny]++;
                     }
                 }
             }
@@ -1120,12 +1037,9 @@ void updateWorkerMaps() {
 
 void updateMageNearbyMap() {
     mageNearbyMap = PathfindingMap(w, h);
-    mageNearbyFuzzyMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_unit_type() == Mage && u.get_location().is_on_map()) {
-            auto pos = u.get_location().get_map_location();
-            mageNearbyMap.maxInfluence(mageProximityInfluence, pos.get_x(), pos.get_y());
-            mageNearbyFuzzyMap.maxInfluence(mageNearbyFuzzyInfluence, pos.get_x(), pos.get_y());
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Mage) {
+            mageNearbyMap.maxInfluence(mageProximityInfluence, u.get_x(), u.get_y());
         }
     }
 }
@@ -1133,18 +1047,14 @@ void updateMageNearbyMap() {
 void updateStructureProximityMap() {
     structureProximityMap = PathfindingMap(w, h);
     rocketProximityMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_location().is_on_map()) {
-            if (u.get_unit_type() == Factory && u.structure_is_built()) {
-                auto pos = u.get_location().get_map_location();
-                structureProximityMap.maxInfluence(factoryProximityInfluence, pos.get_x(), pos.get_y());
-            }
-            if (u.get_unit_type() == Rocket) {
-                auto pos = u.get_location().get_map_location();
-                rocketProximityMap.maxInfluence(rocketProximityInfluence, pos.get_x(), pos.get_y());
-                if (u.structure_is_built()) {
-                    structureProximityMap.maxInfluence(rocketProximityInfluence, pos.get_x(), pos.get_y());
-                }
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Factory && u.structure_is_built()) {
+            structureProximityMap.maxInfluence(factoryProximityInfluence, u.get_x(), u.get_y());
+        }
+        if (u.get_unit_type() == Rocket) {
+            rocketProximityMap.maxInfluence(rocketProximityInfluence, u.get_x(), u.get_y());
+            if (u.structure_is_built()) {
+                structureProximityMap.maxInfluence(rocketProximityInfluence, u.get_x(), u.get_y());
             }
         }
     }
@@ -1187,36 +1097,26 @@ void updateDamagedStructuresMap() {
 }
 
 void updatePassableMap() {
-    passableMap = PathfindingMap(w, h);
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            auto location = MapLocation(gc.get_planet(), i, j);
-            if (planetMap->is_passable_terrain_at(location)) {
-                passableMap.weights[i][j] = 1.0;
-            }
-            else {
-                passableMap.weights[i][j] = numeric_limits<double>::infinity();
-            }
-        }
-    }
+    passableMap = terrainCostMap;
+    freeTiles = passableTerrain;
 
     for (const auto& unit : enemyUnits) {
         auto unitMapLocation = unit.get_location().get_map_location();
-        passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1000;
+        setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1000);
     }
 
     for (const auto& unit : ourUnits) {
         if (unit.get_location().is_on_map()) {
             auto unitMapLocation = unit.get_location().get_map_location();
             if (is_robot(unit.get_unit_type())) {
-                passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1000;
+                setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1000);
             }
             else {
                 if (unit.structure_is_built()) {
-                    passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1.5;
+                    setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1.5);
                 }
                 else {
-                    passableMap.weights[unitMapLocation.get_x()][unitMapLocation.get_y()] = 1000;
+                    setPassable(unitMapLocation.get_x(), unitMapLocation.get_y(), 1000);
                 }
             }
         }
@@ -1234,18 +1134,7 @@ void updateStuckUnitMap() {
         const auto& location = unit.get_location().get_map_location();
         int x = location.get_x();
         int y = location.get_y();
-        int moveDirections = 0;
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                int nx = x+dx;
-                int ny = y+dy;
-                if (nx < 0 || ny < 0 || nx >= w || ny >= h)
-                    continue;
-                if (passableMap.weights[nx][ny] <= 1) {
-                    ++moveDirections;
-                }
-            }
-        }
+        int moveDirections = freeTiles.popcount(x-1, y-1, x+1, y+1);
         if (moveDirections)
             hasUnstuckUnit = true;
         double score = 5.0 / (1.0 + moveDirections * moveDirections);
@@ -1264,7 +1153,7 @@ void updateStuckUnitMap() {
 void updateRocketHazardMap() {
     rocketHazardMap = PathfindingMap(w, h);
     if (planet == Mars) {
-        auto rocketLandingInfo = gc.get_rocket_landings();
+        auto& rocketLandingInfo = gameCache.rocketLandings();
         for (unsigned int round = gc.get_round(); round < gc.get_round() + 10; ++round) {
             const auto rocketLandings = rocketLandingInfo.get_landings_on_round(round);
             for (const auto& landing : rocketLandings) {
@@ -1310,8 +1199,11 @@ void updateRocketHazardMap() {
     }
 }
 
-void updateRocketAttractionMap() {
-    rocketAttractionMap = PathfindingMap(w, h);
+// Only read after round 650 on Earth
+LazyLayer rocketAttractionLayer("rocketAttractionMap", { &ourUnitsSource }, [](PathfindingMap& rocketAttractionMap) {
+    if (planet != Earth) {
+        return;
+    }
     for (auto& u : ourUnits) {
         if (u.get_location().is_on_map()) {
             if (u.get_unit_type() == Rocket && u.structure_is_built() && u.get_structure_garrison().size() < u.get_structure_max_capacity()) {
@@ -1320,14 +1212,13 @@ void updateRocketAttractionMap() {
             }
         }
     }
-}
+});
 
 void updateWithinRangeMap() {
     withinRangeMap = PathfindingMap(w, h);
-    for (auto& u : ourUnits) {
-        if (u.get_location().is_on_map() && u.get_unit_type() == Ranger) {
-            const auto location = u.get_location().get_map_location();
-            withinRangeMap.addInfluence(rangerTargetInfluence, location.get_x(), location.get_y());
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Ranger) {
+            withinRangeMap.addInfluence(rangerTargetInfluence, u.get_x(), u.get_y());
         }
     }
 }
@@ -1375,6 +1266,7 @@ void createUnits() {
                 botUnitPtr->isRocketFodder = true;
             }
             unitMap[id] = botUnitPtr;
+            tickQueue.push_back(id);
         } else {
             botUnitPtr = unitMap[id];
         }
@@ -1384,39 +1276,120 @@ void createUnits() {
 
 map<UnitType, double> timeUsed;
 
-bool tickUnits(bool firstIteration, int unitTypes = -1) {
-    bool anyTickDone = false;
-    for (int iteration = 0; iteration < 2; ++iteration) {
-        for (const auto& unit : ourUnits) {
-            auto unitType = unit.get_unit_type();
-            if (iteration == 0) {
-                if (unitType != Healer) {
-                    continue;
-                }
-            }
-            else {
-                if (unitType == Healer) {
-                    continue;
-                }
-            }
-            auto botunit = unitMap[unit.get_id()];
-            if (botunit == nullptr) {
-                continue;
-            }
-            if (firstIteration) {
-                botunit->hasHarvested = false;
-                botunit->hasDoneTick = false;
-            }
-            if (!botunit->hasDoneTick && (1 << (int)unit.get_unit_type()) & unitTypes) {
-                double start = millis();
-                botunit->tick();
-                double dt = millis() - start;
-                timeUsed[unitType] += dt;
-                anyTickDone |= botunit->hasDoneTick;
+// Speculative work done while we are waiting in gc.next_turn()
+BackgroundTask speculation;
+
+// All units of one type that are going to tick in this pass.
+// The per unit state that the batch needs is read once from the snapshots and stored in arrays parallel to units.
+struct UnitBatch {
+    vector<BotUnit*> units;
+    vector<Position> positions;
+    vector<char> onMap;
+    vector<char> moveReady;
+
+    void add(BotUnit* botunit) {
+        auto& unit = botunit->unit;
+        units.push_back(botunit);
+        bool isOnMap = unit.get_location().is_on_map();
+        onMap.push_back(isOnMap);
+        if (isOnMap) {
+            auto location = unit.get_location().get_map_location();
+            positions.push_back(Position(location.get_x(), location.get_y()));
+            moveReady.push_back(is_robot(unit.get_unit_type()) && unit.get_movement_heat() < 10);
+        }
+        else {
+            positions.push_back(Position());
+            moveReady.push_back(false);
+        }
+    }
+};
+
+// Healers go first so that the units they heal know their new health when they tick.
+// Structures go before the robots like they mostly did when units ticked in ourUnits order (they rarely stand
+// where rangers can shoot), so factories unload into tiles before the military batches plan their moves.
+// Military units go before the workers so that their moves are made from a fresh passableMap.
+const UnitType batchOrder[] = { Healer, Factory, Rocket, Knight, Mage, Ranger, Worker };
+
+// False if the unit has died since the batch was collected, e.g. in the splash of one of our mages.
+// invalidate_unit sets unitMap to null for it, but the snapshot in the batch still has it on the map.
+static bool isAlive(BotUnit* botunit) {
+    auto it = unitMap.find(botunit->id);
+    return it != unitMap.end() && it->second == botunit;
+}
+
+void tickBatch(UnitType type, UnitBatch& batch) {
+    // All units of the type share their target and cost maps (see reusableMaps),
+    // so the maps are built by the first unit and the pathfinding for the whole batch runs in parallel
+    vector<BotUnit*> plannedUnits;
+    vector<Position> plannedPositions;
+    if ((type == Knight || type == Ranger || type == Mage) && !veryLowTimeRemaining && !turnPreempted("movement")) {
+        for (size_t i = 0; i < batch.units.size(); i++) {
+            if (batch.onMap[i] && batch.moveReady[i] && isAlive(batch.units[i])) {
+                plannedUnits.push_back(batch.units[i]);
+                plannedPositions.push_back(batch.positions[i]);
             }
         }
+        planMoves(plannedUnits, plannedPositions);
+    }
+
+    double start = millis();
+    for (auto botunit : batch.units) {
+        if (!isAlive(botunit)) {
+            // Killed by an earlier unit of this batch after its move was planned
+            botunit->movePlan.valid = false;
+            continue;
+        }
+        if (!botunit->hasDoneTick) {
+            botunit->tick();
+        }
+    }
+    timeUsed[type] += millis() - start;
+
+    for (auto botunit : plannedUnits) {
+        botunit->movePlan.valid = false;
+    }
+}
+
+void tickUnits(bool firstIteration, int unitTypes = -1) {
+    // ourUnits is sorted by priority, and the batches keep that order within each type
+    UnitBatch batches[7];
+    for (const auto& unit : ourUnits) {
+        auto botunit = unitMap[unit.get_id()];
+        if (botunit == nullptr) {
+            continue;
+        }
+        if (firstIteration) {
+            botunit->hasHarvested = false;
+            botunit->hasDoneTick = false;
+        }
+        auto unitType = unit.get_unit_type();
+        if (!botunit->hasDoneTick && (1 << (int)unitType) & unitTypes) {
+            batches[unitType].add(botunit);
+        }
+    }
+
+    for (auto type : batchOrder) {
+        if (!batches[type].units.empty()) {
+            tickBatch(type, batches[type]);
+        }
+    }
+}
+
+// Ticks the units in tickQueue that have not done their tick yet
+void tickQueuedUnits() {
+    while (!tickQueue.empty()) {
+        auto id = tickQueue.front();
+        tickQueue.pop_front();
+        auto it = unitMap.find(id);
+        if (it == unitMap.end() || it->second == nullptr || it->second->hasDoneTick) {
+            continue;
+        }
+        auto botunit = it->second;
+        double start = millis();
+        botunit->tick();
+        double dt = millis() - start;
+        timeUsed[botunit->unit.get_unit_type()] += dt;
     }
-    return anyTickDone;
 }
 
 void doOvercharge() {
@@ -1435,9 +1408,13 @@ void doOvercharge() {
     }
 }
 
+// Karbonite we had when the last executeMacroObjects call could not pay for a macro object, -1 if it paid for everything
+int unpaidMacroKarbonite = -1;
+
 void executeMacroObjects() {
     sort(macroObjects.rbegin(), macroObjects.rend());
     bestMacroObjectScore = 0;
+    unpaidMacroKarbonite = -1;
     bool failedPaying = false;
     for (auto& macroObject : macroObjects) {
         if (macroObject.score <= 0) {
@@ -1449,6 +1426,9 @@ void executeMacroObjects() {
         if (gc.get_karbonite() >= macroObject.cost) {
             macroObject.execute();
         } else {
+            if (!failedPaying) {
+                unpaidMacroKarbonite = gc.get_karbonite();
+            }
             failedPaying = true;
             bestMacroObjectScore = macroObject.score;
         }
@@ -1458,15 +1438,15 @@ void executeMacroObjects() {
 
 Researcher researcher;
 void updateResearch() {
-    auto researchInfo = gc.get_research_info();
+    const auto& researchInfo = gameCache.researchInfo();
     if (researchInfo.get_queue().size() == 0) {
         auto type = researcher.getBestResearch();
-        gc.queue_research(type);
+        gameCache.queueResearch(type);
     }
 }
 
 void updateResearchStatus() {
-    auto researchInfo = gc.get_research_info();
+    const auto& researchInfo = gameCache.researchInfo();
     if (researchInfo.get_level(Healer) >= 3) {
         hasOvercharge = true;
     }
@@ -1480,7 +1460,7 @@ int computeConnectedness() {
 
     int connectedness = 0;
     Pathfinder pathfinder;
-    auto& initial_units = gc.get_starting_planet(Earth).get_initial_units();
+    auto& initial_units = gameCache.initialUnits(Earth);
     for (auto& enemy : initial_units) {
         if (enemy.get_team() == enemyTeam && enemy.get_location().is_on_map()) {
             targetMap.addInfluence(1000, enemy.get_map_location());
@@ -1522,8 +1502,15 @@ void coordinateRangerAttacks() {
     if (!hasOvercharge || !state.typeCount[Ranger]) {
         return;
     }
+    // Like the mage chains, the work is cut short when the coordination budget is used up, but never before the first
+    // ranger and the first target. ourUnits is sorted by rangerCanShootEnemyCountMap, so the rangers that can shoot
+    // at the most enemies are looked at first.
     map<unsigned int, vector<unsigned int> > rangerTargets;
-    for (auto& unit : ourUnits) {
+    for (auto it = ourUnits.rbegin(); it != ourUnits.rend(); ++it) {
+        auto& unit = *it;
+        if (!rangerTargets.empty() && timeBudget.overBudget(TimePhase::Coordination)) {
+            break;
+        }
         if (unit.get_unit_type() == Ranger && unit.get_location().is_on_map()) {
             int attackRange = unit.get_attack_range();
             const auto locus = unit.get_location().get_map_location();
@@ -1532,7 +1519,7 @@ void coordinateRangerAttacks() {
             if (!exists_enemy_in_range(x, y, attackRange)) {
                 continue;
             }
-            const auto nearby = gc.sense_nearby_units(locus, attackRange);
+            const auto nearby = senseNearbyUnits(locus, attackRange);
             vector<unsigned int> targets;
             for (const auto& enemy : nearby) {
                 if (enemy.get_team() != unit.get_team() && enemy.get_unit_type() != Worker)
@@ -1543,7 +1530,7 @@ void coordinateRangerAttacks() {
     }
     map<unsigned int, set<int> > targetedBy;
     map<pair<int, int>, int> shooter;
-    auto researchInfo = gc.get_research_info();
+    const auto& researchInfo = gameCache.researchInfo();
     for (auto& unit : ourUnits) {
         if (unit.get_unit_type() == Healer && unit.get_location().is_on_map()) {
             if (unit.get_ability_heat() >= 10)
@@ -1552,7 +1539,7 @@ void coordinateRangerAttacks() {
             const auto locus = unit.get_location().get_map_location();
             if (mageNearbyMap.weights[locus.get_x()][locus.get_y()] > 0 && researchInfo.get_level(Mage) >= 3)
                 continue;
-            const auto nearby = gc.sense_nearby_units(locus, attackRange);
+            const auto nearby = senseNearbyUnits(locus, attackRange);
             for (const auto& ranger : nearby) {
                 if (ranger.get_team() == unit.get_team() && ranger.get_unit_type() == Ranger) {
                     for (const unsigned int enemyId : rangerTargets[ranger.get_id()]) {
@@ -1563,12 +1550,17 @@ void coordinateRangerAttacks() {
             }
         }
     }
+    bool anyTarget = false;
     for (auto it : targetedBy) {
+        if (anyTarget && timeBudget.overBudget(TimePhase::Coordination)) {
+            break;
+        }
         if (!gc.can_sense_unit(it.first))
             continue;
         Unit unit = gc.get_unit(it.first);
         unsigned int hitsRequired = ceil(unit.get_health() / 30.0);
         if (it.second.size() >= hitsRequired) {
+            anyTarget = true;
             for (const auto& healerId : it.second) {
                 if (!gc.can_sense_unit(it.first))
                     continue;
@@ -1594,11 +1586,11 @@ void coordinateRangerAttacks() {
                 if (dx*dx + dy*dy > 30)
                     continue;
                 gc.overcharge(healerId, rangerId);
+                onOvercharge(healerId, rangerId);
                 if (gc.can_attack(rangerId, it.first)) {
                     gc.attack(rangerId, it.first);
+                    onAttack(rangerId, unit.get_location().get_map_location());
                 }
-                invalidate_unit(healerId);
-                invalidate_unit(rangerId);
                 for (auto& it2 : targetedBy) {
                     it2.second.erase(healerId);
                 }
@@ -1615,7 +1607,17 @@ void coordinateMageAttacks() {
         return;
     }
     auto start = millis();
+    bool firstRound = true;
     while (true) {
+        // Each round finds one more overcharge chain, later rounds are skipped when the budget is used up
+        if (!firstRound && timeBudget.overBudget(TimePhase::Coordination)) {
+            break;
+        }
+        // The chains found so far have already been executed
+        if (turnPreempted("mage coordination")) {
+            break;
+        }
+        firstRound = false;
         PathfindingMap canShootAtMap(w, h);
         PathfindingMap shootMap(w, h);
         PathfindingMap healerMap(w, h);
@@ -1734,9 +1736,9 @@ void coordinateMageAttacks() {
                     int ny = y+dy;
                     if (nx < 0 || ny < 0 || nx >= w || ny >= h)
                         continue;
-                    if (!canSenseLocation[nx][ny])
+                    if (!canSenseLocation.test(nx, ny))
                         continue;
-                    if (passableMap.weights[nx][ny] > 1)
+                    if (!freeTiles.test(nx, ny))
                         continue;
                     if (D < distanceToMage.weights[nx][ny]) {
                         distanceToMage.weights[nx][ny] = D;
@@ -1761,9 +1763,9 @@ void coordinateMageAttacks() {
                         int ny = y+dy;
                         if (nx < 0 || ny < 0 || nx >= w || ny >= h)
                             continue;
-                        if (!canSenseLocation[nx][ny])
+                        if (!canSenseLocation.test(nx, ny))
                             continue;
-                        if (passableMap.weights[nx][ny] > 1)
+                        if (!freeTiles.test(nx, ny))
                             continue;
                         if (D < distanceToMage.weights[nx][ny]) {
                             distanceToMage.weights[nx][ny] = D;
@@ -1816,7 +1818,7 @@ void coordinateMageAttacks() {
             }
 #endif
             MapLocation location(planet, path[0].first, path[0].second);
-            if (!canSenseLocation[path[0].first][path[0].second]) {
+            if (!canSenseLocation.test(path[0].first, path[0].second)) {
 #ifndef NDEBUG
                 cout << "Error! Couldn't sense location!" << endl;
 #endif
@@ -1878,8 +1880,7 @@ void coordinateMageAttacks() {
                     }
                     if (bestScore > 0) {
                         gc.overcharge(bestUnitId, botUnit->unit.get_id());
-                        invalidate_unit(botUnit->unit.get_id());
-                        invalidate_unit(bestUnitId);
+                        onOvercharge(bestUnitId, botUnit->unit.get_id());
                         //assert(botUnit->unit.get_attack_heat() == 0);
                         //assert(botUnit->unit.get_movement_heat() == 0);
                         anyOvercharge = true;
@@ -1897,9 +1898,9 @@ void coordinateMageAttacks() {
                     int j = min(i+1, path.size()-1);
                     const MapLocation blinkTo(planet, path[j].first, path[j].second);
                     if (gc.can_begin_blink(botUnit->unit.get_id(), blinkTo)) {
-                        passableMap.weights[location.get_x()][location.get_y()] = 1;
+                        setPassable(location.get_x(), location.get_y(), 1);
                         gc.blink(botUnit->unit.get_id(), blinkTo);
-                        invalidate_unit(botUnit->unit.get_id());
+                        onBlink(botUnit->unit.get_id());
                         mage_attack(botUnit->unit);
                         if (botUnit == nullptr) {
 #ifndef NDEBUG
@@ -1912,7 +1913,7 @@ void coordinateMageAttacks() {
                         anyOvercharge = true;
                         location = blinkTo;
                         hasDoneAnything = true;
-                        passableMap.weights[location.get_x()][location.get_y()] = 1000;
+                        setPassable(location.get_x(), location.get_y(), 1000);
                     }
                 }
                 if (i < path.size()-1) {
@@ -1948,13 +1949,86 @@ void coordinateMageAttacks() {
         }
         if (!anyOvercharge)
             break;
-        invalidate_units();
         findUnits();
         createUnits();
     }
     mageCoordinationTime += millis()-start;
 }
 
+TaskScheduler mapUpdateScheduler;
+
+static uint64_t checksumMaps(std::initializer_list<const PathfindingMap*> maps) {
+    uint64_t hash = checksumBytes(nullptr, 0);
+    for (auto map : maps) {
+        for (auto& column : map->weights) {
+            hash = checksumBytes(column.data(), column.size() * sizeof(double), hash);
+        }
+    }
+    return hash;
+}
+
+static uint64_t checksumBitboard(const Bitboard& bitboard) {
+    return checksumBytes(bitboard.bits, sizeof(bitboard.bits));
+}
+
+// Declares the per-turn map updates together with the maps they read and write.
+// Updates that do not depend on each other are run in parallel.
+void initMapUpdateTasks() {
+    auto& scheduler = mapUpdateScheduler;
+    int engine = scheduler.engine();
+    // ourUnitInfos and enemyUnitInfos, only read by the tasks
+    int units = scheduler.addResource("unit snapshots", nullptr);
+    int staticMaps = scheduler.addResource("static maps", [] {
+        return checksumMaps({ &ourStartingPositionMap, &distanceToInitialLocation[0], &distanceToInitialLocation[1], &initialEnemyProximityMap });
+    });
+    int vision = scheduler.addResource("canSenseLocation", [] { return checksumBitboard(canSenseLocation); });
+    int discovery = scheduler.addResource("discoveryMap", [] { return checksumMaps({ &discoveryMap }); });
+    int karbonite = scheduler.addResource("karboniteMap", [] { return checksumMaps({ &karboniteMap }); });
+    int passable = scheduler.addResource("passableMap", [] { return checksumMaps({ &passableMap }); });
+    int enemyPositions = scheduler.addResource("enemyPositionMap", [] { return checksumMaps({ &enemyPositionMap }); });
+    int nearbyFriends = scheduler.addResource("nearbyFriendMap", [] { return checksumMaps({ &nearbyFriendMap }); });
+    int workerMaps = scheduler.addResource("worker maps", [] {
+        return checksumMaps({ &workerProximityMap, &workerAdditiveMap, &workersNextToMap });
+    });
+    int fuzzyKarbonite = scheduler.addResource("fuzzyKarboniteMap", [] {
+        return checksumMaps({ &fuzzyKarboniteMap }) ^ contestedKarbonite;
+    });
+    int enemyInfluence = scheduler.addResource("enemy influence maps", [] {
+        return checksumMaps({ &enemyInfluenceMap, &enemyNearbyMap, &enemyFactoryNearbyMap, &rangerCanShootEnemyCountMap }) ^ checksumBitboard(enemyExactPositions);
+    });
+    int mageNearby = scheduler.addResource("mageNearbyMap", [] { return checksumMaps({ &mageNearbyMap }); });
+    int structureProximity = scheduler.addResource("structure proximity maps", [] {
+        return checksumMaps({ &structureProximityMap, &rocketProximityMap });
+    });
+    int damagedStructures = scheduler.addResource("damagedStructureMap", [] { return checksumMaps({ &damagedStructureMap }); });
+    int enemyEstimates = scheduler.addResource("enemy composition", [] {
+        double values[] = { (double)enemyHasRangers, (double)enemyHasMages, (double)enemyHasKnights, estimatedEnemyRangers, estimatedEnemyKnights };
+        return checksumBytes(values, sizeof(values));
+    });
+    int withinRange = scheduler.addResource("withinRangeMap", [] { return checksumMaps({ &withinRangeMap }); });
+    int rocketHazard = scheduler.addResource("rocketHazardMap", [] { return checksumMaps({ &rocketHazardMap }); });
+
+    scheduler.addTask("discovery", { vision }, { discovery }, updateDiscoveryMap);
+    scheduler.addTask("asteroids", {}, { engine, karbonite }, updateAsteroids);
+    scheduler.addTask("enemy positions", { passable }, { enemyPositions }, updateEnemyPositionMap);
+    scheduler.addTask("nearby friends", { units }, { nearbyFriends }, updateNearbyFriendMap);
+    scheduler.addTask("workers", { units }, { workerMaps }, updateWorkerMaps);
+    // Also clears the enemy position map on all tiles that we can see
+    scheduler.addTask("karbonite", { vision, staticMaps }, { engine, karbonite, enemyPositions }, updateKarboniteMap);
+    scheduler.addTask("fuzzy karbonite", { karbonite, staticMaps, workerMaps }, { fuzzyKarbonite }, updateFuzzyKarboniteMap);
+    scheduler.addTask("enemy influence", { units, staticMaps }, { enemyInfluence, enemyPositions }, updateEnemyInfluenceMaps);
+    scheduler.addTask("mage nearby", { units }, { mageNearby }, updateMageNearbyMap);
+    scheduler.addTask("structure proximity", { units }, { structureProximity }, updateStructureProximityMap);
+    scheduler.addTask("damaged structures", { workerMaps }, { engine, damagedStructures }, updateDamagedStructuresMap);
+    scheduler.addTask("enemy composition", { units }, { enemyEstimates }, [] {
+        updateEnemyHasRangers();
+        updateEnemyHasMages();
+        updateEnemyHasKnights();
+    });
+    scheduler.addTask("within range", { units }, { withinRange }, updateWithinRangeMap);
+    scheduler.addTask("rocket hazard", {}, { engine, rocketHazard }, updateRocketHazardMap);
+}
+
 #ifdef CUSTOM_BACKTRACE
 void* __libc_stack_end;
 #endif
@@ -2000,11 +2074,10 @@ int main() {
     initKarboniteMap();
     initInfluence();
 
-    computeOurStartingPositionMap();
+    initStaticMaps();
     updatePassableMap();
     discoveryMap = PathfindingMap(w, h);
     if (planet == Earth) {
-        computeDistancesToInitialLocations();
         mapConnectedness = computeConnectedness();
         existsPathToEnemy = mapConnectedness > 0;
 #ifndef NDEBUG
@@ -2021,10 +2094,12 @@ int main() {
         mapConnectedness = 10;
         existsPathToEnemy = true;
     }
+    karboniteIndex.computeWeights();
 
     anyReasonableLandingSpotOnInitialMars = get<0>(find_best_landing_spot());
 
     enemyPositionMap = PathfindingMap(w, h);
+    initMapUpdateTasks();
     // Write that we have no rockets in the beginning.
     gc.write_team_array(1, 0);
 
@@ -2042,7 +2117,7 @@ int main() {
     turnsSinceLastFight = 0;
     // loop through the whole game.
     while (true) {
-        time_t t0 = millis();
+        double t0 = millis();
         unsigned round = gc.get_round();
         sigTheRound = (sig_atomic_t)round;
         printf("Round: %d\n", round);
@@ -2052,45 +2127,33 @@ int main() {
         // If less than 0.5 seconds left, then enter low power mode
         lowTimeRemaining = timeLeft < 4000;
         veryLowTimeRemaining = timeLeft < 1000;
+        // Above the very low time threshold the phases scale their effort according to the budget
+        timeBudget.startTurn(timeLeft, round);
+        armTurnDeadline(timeBudget.deadline());
         if (lowTimeRemaining) {
             printf("LOW TIME REMAINING\n");
         }
         printf("Time remaining: %d\n", timeLeft);
 
         ++turnsSinceLastFight;
+        gameCache.onNewTurn();
+        resetLazyLayerStats();
         updateResearchStatus();
         findUnits();
 
         updateCanSenseLocation();
-        updateDiscoveryMap();
         reusableMaps.clear();
-        updateAsteroids();
-        updateEnemyPositionMap();
-        updateNearbyFriendMap();
 
         fflush(stdout);
         fflush(stderr);
 
-        // NOTE: this call also updates enemy position map for some reason
-        updateWorkerMaps();
-        updateKarboniteMap();
-        updateFuzzyKarboniteMap();
-        updateEnemyInfluenceMaps();
-        updateMageNearbyMap();
-        updateStructureProximityMap();
-        updateDamagedStructuresMap();
-        updateEnemyHasRangers();
-        updateEnemyHasMages();
-        updateEnemyHasKnights();
-        updateWithinRangeMap();
+        {
+            TimeBudget::Scope scope(timeBudget, TimePhase::Maps);
+            mapUpdateScheduler.run(threadPool);
 
-        updateRocketHazardMap();
-        if (planet == Earth) {
-            updateRocketAttractionMap();
+            if (timeBudget.quality(TimePhase::Maps) >= 0.5 && !turnPreempted("enemy analysis")) analyzeEnemyPositions();
         }
 
-        if (!lowTimeRemaining) analyzeEnemyPositions();
-
         unitShouldGoToRocket.clear();
 
         for (auto& unit : ourUnits) {
@@ -2112,10 +2175,10 @@ int main() {
         
         if (planet == Earth) {
             state.remainingKarboniteOnEarth = 0;
-            for (int x = 0; x < w; x++) {
-                for (int y = 0; y < h; y++) {
-                    state.remainingKarboniteOnEarth += 20.0 * karboniteMap.weights[x][y] / (distanceToInitialLocation[ourTeam].weights[x][y] + 10.0 + gc.get_round() * 0.4);
-                }
+            for (auto& tile : karboniteIndex.tiles) {
+                int x = tile.first;
+                int y = tile.second;
+                state.remainingKarboniteOnEarth += 20.0 * karboniteMap.weights[x][y] / (distanceToInitialLocation[ourTeam].weights[x][y] + 10.0 + gc.get_round() * 0.4);
             }
         }
         state.earthTotalUnitCount = gc.get_team_array(Earth)[0];
@@ -2128,7 +2191,10 @@ int main() {
 
         // WIP
         createUnits();
-        matchWorkers();
+        {
+            TimeBudget::Scope scope(timeBudget, TimePhase::Matching);
+            matchWorkers();
+        }
 
         if (!hasUnstuckUnit && state.typeCount[Rocket] == 0 && planet == Earth) {
             bool hasDisintegrated = false;
@@ -2161,30 +2227,51 @@ int main() {
                 }
             }
             findUnits();
+            updateCanSenseLocation();
             createUnits();
         }
 
         auto t1 = millis();
         preprocessingComputationTime += t1-t0;
 
+        // The first iteration ticks every unit.
+        // After that only units in tickQueue are ticked, they are queued when something happens that may let them act
+        // (e.g. they were unloaded or created). We stop once nothing is queued and no macro object is waiting for karbonite.
         bool firstIteration = true;
         workersMove = false;
+        tickQueue.clear();
         while (true) {
             fflush(stdout);
             fflush(stderr);
             auto t2 = millis();
-            createUnits();
+            // createUnits copies the snapshots from ourUnits, so it must not run on a stale ourUnits
+            if (unitsCreated) {
+                findUnits();
+                // The new units were never added to the vision counts
+                updateCanSenseLocation();
+                createUnits();
+            }
+            else if (firstIteration) {
+                createUnits();
+            }
 #ifndef NDEBUG
             cout << "We have " << ourUnits.size() << " units" << endl;
 #endif
-            if (!veryLowTimeRemaining) {
+            if (!veryLowTimeRemaining && timeBudget.quality(TimePhase::Coordination) > 0) {
+                TimeBudget::Scope scope(timeBudget, TimePhase::Coordination);
                 coordinateMageAttacks();
             }
-            bool anyTickDone = tickUnits(firstIteration, 1 << (int)Healer);
-
-            anyTickDone |= tickUnits(false);
-            if (hasOvercharge) doOvercharge();
-            addWorkerActions();
+            {
+                TimeBudget::Scope scope(timeBudget, TimePhase::Ticks);
+                if (firstIteration) {
+                    tickUnits(true);
+                }
+                else {
+                    tickQueuedUnits();
+                }
+                if (hasOvercharge) doOvercharge();
+                addWorkerActions();
+            }
             auto t3 = millis();
 #ifndef NDEBUG
             cout << "Iteration: " << (t3 - t2) << endl;
@@ -2192,26 +2279,34 @@ int main() {
             
             executeMacroObjects();
 
-            if (firstIteration && !veryLowTimeRemaining) {
+            if (firstIteration && !veryLowTimeRemaining && !turnPreempted("movement")) {
                 workersMove = true;
                 updateFuzzyKarboniteMap();
                 findUnits();
+                updateCanSenseLocation();
                 createUnits();
                 updateDamagedStructuresMap();
                 MapReuseObject reuseObject(MapType::Target, Worker, false);
                 reusableMaps.erase(reuseObject);
                 reuseObject.isHurt = true;
                 reusableMaps.erase(reuseObject);
-                anyTickDone |= tickUnits(false, 1 << (int)Worker);
+                TimeBudget::Scope scope(timeBudget, TimePhase::Ticks);
+                tickUnits(false, 1 << (int)Worker);
             }
             firstIteration = false;
-            if (!veryLowTimeRemaining) {
+            if (!veryLowTimeRemaining && timeBudget.quality(TimePhase::Coordination) > 0 && !turnPreempted("ranger coordination")) {
+                TimeBudget::Scope scope(timeBudget, TimePhase::Coordination);
                 coordinateRangerAttacks();
             }
 
-            if (!anyTickDone) break;
+#ifndef NDEBUG
+            verifyUnitSnapshots();
+#endif
+
+            bool karboniteForUnpaidMacro = unpaidMacroKarbonite >= 0 && (int)gc.get_karbonite() > unpaidMacroKarbonite;
+            if (tickQueue.empty() && !unitsCreated && !karboniteForUnpaidMacro) break;
+            if (turnPreempted("turn loop")) break;
 
-            findUnits();
             // auto t4 = millis();
             // cout << "Execute: " << (t4 - t3) << endl;
         }
@@ -2224,6 +2319,11 @@ int main() {
 
         double turnTime = millis() - t0;
         totalTurnTime += turnTime;
+        timeBudget.endTurn();
+        disarmTurnDeadline();
+        if (preemptedPhase != nullptr) {
+            printf("Turn preempted in %s\n", preemptedPhase);
+        }
 
         //if (!lowTimeRemaining)
 #ifndef NDEBUG
@@ -2235,14 +2335,21 @@ int main() {
             cout << "   Target map computation time: " << std::round(targetMapComputationTime) << endl;
             cout << "   Cost map computation time: " << std::round(costMapComputationTime) << endl;
             cout << "Pathfinding time: " << std::round(pathfindingTime) << endl;
+            cout << "   Move plans: " << movePlansUsed << " used, " << movePlansReplanned << " replanned" << endl;
             cout << "Attack computation time: " << std::round(attackComputationTime) << endl;
             cout << "Mage coordination time: " << std::round(mageCoordinationTime) << endl;
             cout << "Invalidation time: " << std::round(unitInvalidationTime) << endl;
+            timeBudget.printStats();
+            printLazyLayerStats();
+            cout << "Speculative time maps used: " << speculativeTimeMapHits << endl;
+            timeMapCache.printStats();
+            cout << "Game cache: " << gameCache.hits << " hits, " << gameCache.misses << " misses" << endl;
             cout << "Preprocessing time: " << std::round(preprocessingComputationTime) << endl;
             cout << "Match workers time: " << std::round(matchWorkersTime) << endl;
             cout << "  Dijkstra time: " << std::round(matchWorkersDijkstraTime) << endl;
             cout << "  Dijkstra2 time: " << std::round(matchWorkersDijkstraTime2) << endl;
-            cout << "  Hungarian time: " << std::round(hungarianTime) << endl;
+            cout << "  Assignment time: " << std::round(assignmentTime) << endl;
+            cout << "  Augmentations: " << matchingAugmentations << endl;
             for (auto it : timeUsed) {
                 cout << unitTypeToString[it.first] << ": " << std::round(it.second) << endl;
             }
@@ -2267,7 +2374,10 @@ int main() {
 #ifndef NDEBUG
         cout << "Calling gc.next_turn()" << endl;
 #endif
+        // Use the time while the other players move, the results are checked before they are used
+        speculation.start({ speculateWorkerTimeMaps(speculation), speculateMarsKarbonite() });
         gc.next_turn();
+        speculation.finish();
     }
     // I'm convinced C++ is the better option :)
 }
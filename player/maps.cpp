@@ -11,23 +11,27 @@ PathfindingMap workersNextToMap;
 PathfindingMap structureProximityMap;
 PathfindingMap damagedStructureMap;
 PathfindingMap passableMap;
+Bitboard freeTiles;
+Bitboard passableTerrain;
 PathfindingMap enemyNearbyMap;
 PathfindingMap enemyFactoryNearbyMap;
 PathfindingMap enemyPositionMap;
-PathfindingMap enemyExactPositionMap;
+Bitboard enemyExactPositions;
+Bitboard unitOccupancy;
 PathfindingMap nearbyFriendMap;
 PathfindingMap rocketHazardMap;
-PathfindingMap rocketAttractionMap;
 PathfindingMap rocketProximityMap;
-PathfindingMap healerOverchargeMap;
 PathfindingMap stuckUnitMap;
 PathfindingMap mageNearbyMap;
-PathfindingMap mageNearbyFuzzyMap;
 PathfindingMap ourStartingPositionMap;
 PathfindingMap discoveryMap;
 PathfindingMap distanceToInitialLocation[2];
 PathfindingMap withinRangeMap;
 PathfindingMap rangerCanShootEnemyCountMap;
-PathfindingMap enemyKnightNearbyMap;
 
 map<MapReuseObject, PathfindingMap> reusableMaps;
+
+void setPassable(int x, int y, double weight) {
+    passableMap.weights[x][y] = weight;
+    freeTiles.set(x, y, weight <= 1);
+}
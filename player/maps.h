@@ -2,6 +2,8 @@
 
 #include "common.h"
 #include "pathfinding.hpp"
+#include "bitboard.hpp"
+#include "lazylayer.h"
 
 extern PathfindingMap karboniteMap;
 extern PathfindingMap fuzzyKarboniteMap;
@@ -12,24 +14,35 @@ extern PathfindingMap workersNextToMap;
 extern PathfindingMap structureProximityMap;
 extern PathfindingMap damagedStructureMap;
 extern PathfindingMap passableMap;
+// Tiles where passableMap is at most 1, i.e. tiles that we can move to right now.
+// Kept in sync by setPassable.
+extern Bitboard freeTiles;
+// Terrain passability, which never changes during the game
+extern Bitboard passableTerrain;
 extern PathfindingMap enemyNearbyMap;
 extern PathfindingMap enemyFactoryNearbyMap;
 extern PathfindingMap enemyPositionMap;
-extern PathfindingMap enemyExactPositionMap;
+extern Bitboard enemyExactPositions;
+// Tiles which have a unit in unitAtLocation
+extern Bitboard unitOccupancy;
 extern PathfindingMap nearbyFriendMap;
 extern PathfindingMap rocketHazardMap;
-extern PathfindingMap rocketAttractionMap;
 extern PathfindingMap rocketProximityMap;
-extern PathfindingMap healerOverchargeMap;
 extern PathfindingMap stuckUnitMap;
 extern PathfindingMap mageNearbyMap;
-extern PathfindingMap mageNearbyFuzzyMap;
 extern PathfindingMap ourStartingPositionMap;
 extern PathfindingMap discoveryMap;
 extern PathfindingMap distanceToInitialLocation[2];
 extern PathfindingMap withinRangeMap;
 extern PathfindingMap rangerCanShootEnemyCountMap;
-extern PathfindingMap enemyKnightNearbyMap;
+
+// Layers that are only computed when something reads them
+extern LazyLayer rocketAttractionLayer;
+extern LazyLayer healerOverchargeLayer;
+extern LazyLayer mageNearbyFuzzyLayer;
+extern LazyLayer enemyKnightNearbyLayer;
+
+void setPassable(int x, int y, double weight);
 
 enum class MapType { Target, Cost };
 
@@ -0,0 +1,112 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+// One core is left for the main thread, and there is little to gain from more than a few threads
+ThreadPool threadPool(min(3, max(0, (int)thread::hardware_concurrency() - 1)));
+
+ThreadPool::ThreadPool(int threads) {
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> job;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void ThreadPool::submit(function<void()> job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::parallelFor(int n, const function<void(int)>& f) {
+    if (workers.empty() || n <= 1) {
+        for (int i = 0; i < n; i++) {
+            f(i);
+        }
+        return;
+    }
+
+    atomic<int> nextIndex(0);
+    int helpers = min((int)workers.size(), n - 1);
+    int remainingHelpers = helpers;
+    std::mutex doneMutex;
+    condition_variable done;
+    auto work = [&] {
+        for (int i = nextIndex++; i < n; i = nextIndex++) {
+            f(i);
+        }
+    };
+    for (int i = 0; i < helpers; i++) {
+        submit([&] {
+            work();
+            lock_guard<std::mutex> lock(doneMutex);
+            if (--remainingHelpers == 0) {
+                done.notify_one();
+            }
+        });
+    }
+    work();
+    unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&] { return remainingHelpers == 0; });
+}
+
+BackgroundTask::~BackgroundTask() {
+    finish();
+}
+
+void BackgroundTask::start(vector<function<void()> > jobs) {
+    finish();
+    cancelFlag = false;
+    thread = std::thread([this, jobs] {
+        for (auto& job : jobs) {
+            if (cancelled()) {
+                break;
+            }
+            if (job) {
+                job();
+            }
+        }
+    });
+}
+
+void BackgroundTask::finish() {
+    if (thread.joinable()) {
+        cancelFlag = true;
+        thread.join();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+// Small fixed size thread pool.
+// Jobs must not call into the game controller, the engine bindings are not thread safe.
+struct ThreadPool {
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    int threadCount() const { return workers.size(); }
+
+    // Run the job on one of the worker threads.
+    // If the pool has no workers the job is run immediately on the calling thread.
+    void submit(std::function<void()> job);
+
+    // Calls f(i) for all i in [0, n) and waits until all calls have finished.
+    // The calling thread takes part in the work.
+    void parallelFor(int n, const std::function<void(int)>& f);
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+// Shared pool used by the bot, sized after the number of available cores
+extern ThreadPool threadPool;
+
+// Runs jobs one after another on a dedicated thread.
+// Used for speculative work while the main thread is blocked in gc.next_turn().
+// The same rules as for the thread pool apply, jobs must not call into the game controller
+// and must not read anything that the main thread modifies while they run.
+struct BackgroundTask {
+    ~BackgroundTask();
+
+    void start(std::vector<std::function<void()> > jobs);
+
+    // Asks the jobs to stop and waits for the thread to exit.
+    // Everything the jobs have written is safe to read after this returns.
+    void finish();
+
+    // Jobs should check this regularly and return early when it is set
+    bool cancelled() const { return cancelFlag.load(std::memory_order_relaxed); }
+
+private:
+    std::thread thread;
+    std::atomic<bool> cancelFlag { false };
+};
@@ -14,6 +14,7 @@
 #include <queue>
 
 #include "common.h"
+#include "bitboard.hpp"
 
 using namespace bc;
 using namespace std;
@@ -252,11 +253,11 @@ struct Pathfinder {
     double bestScore;
 
     bool existsPathToLocation(const MapLocation& from, const MapLocation& to, const PathfindingMap& costs) {
-        static vector<vector<double> > cost(MAX_MAP_SIZE, vector<double>(MAX_MAP_SIZE));
-        static vector<vector<int> > version(MAX_MAP_SIZE, vector<int>(MAX_MAP_SIZE));
-        static vector<vector<Position> > parent(MAX_MAP_SIZE, vector<Position>(MAX_MAP_SIZE));
-        static priority_queue<PathfindingEntry> pq;
-        static int pathfindingVersion = 0;
+        static thread_local vector<vector<double> > cost(MAX_MAP_SIZE, vector<double>(MAX_MAP_SIZE));
+        static thread_local vector<vector<int> > version(MAX_MAP_SIZE, vector<int>(MAX_MAP_SIZE));
+        static thread_local vector<vector<Position> > parent(MAX_MAP_SIZE, vector<Position>(MAX_MAP_SIZE));
+        static thread_local priority_queue<PathfindingEntry> pq;
+        static thread_local int pathfindingVersion = 0;
 
         int w = costs.w;
         int h = costs.h;
@@ -312,7 +313,7 @@ struct Pathfinder {
     }
 
     vector<vector<double>> getDistanceToAllTiles (int x0, int y0, const PathfindingMap& costs) {
-        static priority_queue<PathfindingEntry> pq;
+        static thread_local priority_queue<PathfindingEntry> pq;
 
         int w = costs.w;
         int h = costs.h;
@@ -355,12 +356,70 @@ struct Pathfinder {
         return cost;
     }
 
+    // Like getDistanceToAllTiles, but stops as soon as the distances to all the target tiles are known.
+    // Only the distances to the targets are guaranteed to be exact, other tiles may be too high or infinite.
+    // Does not touch the game controller, so it may be called from worker threads
+    vector<vector<double>> getDistanceToTiles (int x0, int y0, const PathfindingMap& costs, const Bitboard& targets) {
+        static thread_local priority_queue<PathfindingEntry> pq;
+
+        int w = costs.w;
+        int h = costs.h;
+
+        // Make sure map is sane
+        assert(w <= MAX_MAP_SIZE);
+        assert(h <= MAX_MAP_SIZE);
+
+        vector<vector<double> > cost(w, vector<double>(h, numeric_limits<double>::infinity()));
+        Bitboard remaining = targets;
+        int remainingCount = remaining.popcount();
+
+        int dx[8]={1,1,1,0,0,-1,-1,-1};
+        int dy[8]={1,0,-1,1,-1,1,0,-1};
+        pq.push(PathfindingEntry(0.0, Position(x0, y0)));
+        cost[x0][y0] = 0;
+
+        while (!pq.empty() && remainingCount > 0) {
+            auto currentEntry = pq.top();
+            auto currentPos = currentEntry.pos;
+            pq.pop();
+            if (currentEntry.cost > cost[currentPos.x][currentPos.y]) {
+                continue;
+            }
+            if (remaining.test(currentPos.x, currentPos.y)) {
+                remaining.reset(currentPos.x, currentPos.y);
+                remainingCount--;
+            }
+            for (int i = 0; i < 8; i++) {
+                int x = currentPos.x + dx[i];
+                int y = currentPos.y + dy[i];
+                if (x < 0 || x >= w || y < 0 || y >= h) {
+                    continue;
+                }
+                double newCost = currentEntry.cost + costs.weights[x][y];
+                if (newCost < cost[x][y]) {
+                    cost[x][y] = newCost;
+                    pq.push(PathfindingEntry(newCost, Position(x, y)));
+                }
+            }
+        }
+
+        // Clear queue (required as it is reused for the next pathfinding call)
+        while(!pq.empty()) pq.pop();
+
+        return cost;
+    }
+
     vector<Position> getPath (const MapLocation& from, const PathfindingMap& values, const PathfindingMap& costs) {
-        static vector<vector<double> > cost(MAX_MAP_SIZE, vector<double>(MAX_MAP_SIZE));
-        static vector<vector<int> > version(MAX_MAP_SIZE, vector<int>(MAX_MAP_SIZE));
-        static vector<vector<Position> > parent(MAX_MAP_SIZE, vector<Position>(MAX_MAP_SIZE));
-        static priority_queue<PathfindingEntry> pq;
-        static int pathfindingVersion = 0;
+        return getPath(Position(from.get_x(), from.get_y()), values, costs);
+    }
+
+    // Does not touch the game controller, so it may be called from worker threads
+    vector<Position> getPath (Position from, const PathfindingMap& values, const PathfindingMap& costs) {
+        static thread_local vector<vector<double> > cost(MAX_MAP_SIZE, vector<double>(MAX_MAP_SIZE));
+        static thread_local vector<vector<int> > version(MAX_MAP_SIZE, vector<int>(MAX_MAP_SIZE));
+        static thread_local vector<vector<Position> > parent(MAX_MAP_SIZE, vector<Position>(MAX_MAP_SIZE));
+        static thread_local priority_queue<PathfindingEntry> pq;
+        static thread_local int pathfindingVersion = 0;
 
         int w = values.w;
         int h = values.h;
@@ -376,7 +435,7 @@ struct Pathfinder {
         auto averageScore = [&values](Position pos) {
             return values.weights[pos.x][pos.y] / (cost[pos.x][pos.y] + 1.0);
         };
-        int x0 = from.get_x(), y0 = from.get_y();
+        int x0 = from.x, y0 = from.y;
         Position bestPosition(x0, y0);
         cost[x0][y0] = costs.weights[x0][y0];
         bestScore = averageScore(bestPosition);
@@ -1,41 +1,71 @@
 #include "rocket.h"
 #include "pathfinding.hpp"
+#include "gamecache.h"
 using namespace bc;
 using namespace std;
 
 int launchedWorkerCount;
 int countRocketsSent = 0;
 
-vector<vector<double>> mars_karbonite_map(int time) {
-    auto& marsMap = gc.get_starting_planet(Mars);
-    int w = marsMap.get_width();
-    int h = marsMap.get_height();
+// Karbonite on Mars after all asteroids before the given round have landed.
+// Does not use the game controller, so it can run on a background thread.
+vector<vector<double>> compute_mars_karbonite_map(int w, int h, const vector<vector<int>>& initialKarbonite, const vector<AsteroidInfo>& asteroids, int time) {
     vector<vector<double>> res (w, vector<double>(h, 0.0));
 
     // Just in case some karbonite actually exists at mars at start
     for (int x = 0; x < w; x++) {
         for (int y = 0; y < h; y++) {
-            res[x][y] += marsMap.get_initial_karbonite_at(MapLocation(Mars, x, y));
+            res[x][y] += initialKarbonite[x][y];
         }
     }
 
-    auto& asteroids = gc.get_asteroid_pattern();
-    for (int t = 0; t < time; t++) {
-        if (asteroids.has_asteroid_on_round(t)) {
-            auto asteroid = asteroids.get_asteroid_on_round(t);
-            auto loc = asteroid.get_map_location();
-            // Note: Assumes mars and earth have the same size
-            if (isOnMap(loc)) {
-                res[loc.get_x()][loc.get_y()] += asteroid.get_karbonite();
-            }
+    for (auto& asteroid : asteroids) {
+        if (asteroid.round >= time) break;
+        if (asteroid.x < w && asteroid.y < h) {
+            res[asteroid.x][asteroid.y] += asteroid.karbonite;
         }
     }
 
     return res;
 }
 
+// Computed while waiting for the next turn, only valid for the same time argument
+int speculativeMarsKarboniteTime = -1;
+vector<vector<double>> speculativeMarsKarbonite;
+
+vector<vector<double>> mars_karbonite_map(int time) {
+    if (time == speculativeMarsKarboniteTime) {
+        return speculativeMarsKarbonite;
+    }
+    auto& marsMap = gameCache.startingPlanet(Mars);
+    return compute_mars_karbonite_map(marsMap.get_width(), marsMap.get_height(), gameCache.initialKarbonite(Mars), gameCache.asteroids(), time);
+}
+
+function<void()> speculateMarsKarbonite() {
+    speculativeMarsKarboniteTime = -1;
+    if (planet != Earth) return nullptr;
+
+    bool hasRocket = false;
+    for (auto& u : ourUnits) {
+        hasRocket |= u.get_unit_type() == Rocket;
+    }
+    if (!hasRocket) return nullptr;
+
+    // Same time as find_best_landing_spot will use next turn
+    int time = gc.get_round() + 1 + 100;
+    auto& marsMap = gameCache.startingPlanet(Mars);
+    int marsWidth = marsMap.get_width();
+    int marsHeight = marsMap.get_height();
+    auto& initialKarbonite = gameCache.initialKarbonite(Mars);
+    auto& asteroids = gameCache.asteroids();
+    return [=, &initialKarbonite, &asteroids] {
+        speculativeMarsKarbonite = compute_mars_karbonite_map(marsWidth, marsHeight, initialKarbonite, asteroids, time);
+        speculativeMarsKarboniteTime = time;
+    };
+}
+
 bool reasonableTimeToLaunchRocket () {
-    auto& orbit = gc.get_orbit_pattern();
+    auto& orbit = gameCache.orbitPattern();
     double derivative = orbit.get_amplitude() * (2*M_PI / orbit.get_period()) * cos(gc.get_round() * (2*M_PI / orbit.get_period()));
     // Only launch if the travel time will not be reduced by more than 1 turn by simply waiting 1 turn.
     return derivative >= -1;
@@ -46,12 +76,14 @@ PathfindingMap dontLandSpots(MAX_MAP_SIZE,MAX_MAP_SIZE);
 
 tuple<bool,MapLocation,int> find_best_landing_spot() {
     cout << "Finding landing spot" << endl;
-    auto& marsMap = gc.get_starting_planet(Mars);
-    
+    auto& marsMap = gameCache.startingPlanet(Mars);
+    auto& marsTerrain = gameCache.terrainPassability(Mars);
+
     int w = marsMap.get_width();
     int h = marsMap.get_height();
     auto karb = mars_karbonite_map(gc.get_round() + 100);
-    vector<vector<bool>> searched (w, vector<bool>(h, false));
+    // Like marsTerrain this is sized for Mars, so only test and set may be used on it
+    Bitboard searched;
 
     float bestScore = -1;
     int bestRegion = 0;
@@ -60,16 +92,16 @@ tuple<bool,MapLocation,int> find_best_landing_spot() {
     int region = 0;
     for (int x = 0; x < w; x++) {
         for (int y = 0; y < h; y++) {
-            if (searched[x][y]) continue;
+            if (searched.test(x, y)) continue;
 
-            if (marsMap.is_passable_terrain_at(MapLocation(Mars, x, y))) {
+            if (marsTerrain.test(x, y)) {
                 // Note: assumes that regions never change!!
                 // Otherwise the region IDs will get messed up
                 region++;
 
                 stack<pii> que;
                 que.push(pii(x,y));
-                searched[x][y] = true;
+                searched.set(x, y);
                 int totalResources = 0;
                 int totalArea = 0;
 
@@ -100,9 +132,9 @@ tuple<bool,MapLocation,int> find_best_landing_spot() {
                         for (int dy = -1; dy <= 1; dy++) {
                             int nx = p.first + dx;
                             int ny = p.second + dy;
-                            if (nx >= 0 && ny >= 0 && nx < w && ny < h && !searched[nx][ny]) {
-                                searched[nx][ny] = true;
-                                if (marsMap.is_passable_terrain_at(MapLocation(Mars, nx, ny))) {
+                            if (nx >= 0 && ny >= 0 && nx < w && ny < h && !searched.test(nx, ny)) {
+                                searched.set(nx, ny);
+                                if (marsTerrain.test(nx, ny)) {
                                     que.push(pii(nx, ny));
                                 }
                             }
@@ -144,7 +176,7 @@ void BotRocket::tick() {
     } else {
         int workerCount = 0;
         for (auto u : unit.get_structure_garrison()) {
-            if (gc.get_unit(u).get_unit_type() == Worker) {
+            if (gameCache.unitType(u) == Worker) {
                 ++workerCount;
             }
         }
@@ -160,8 +192,9 @@ void BotRocket::tick() {
                     // Heavily discourage ladning in the same 3x3 region as this rocket.
                     double reductionFactor = 10;
                     dontLandSpots.addInfluence(vector<vector<double>>(3, vector<double>(3, reductionFactor)), landingSpot.get_x(), landingSpot.get_y());
+                    auto garrison = unit.get_structure_garrison();
                     gc.launch_rocket(unit.get_id(), landingSpot);
-                    invalidate_units();
+                    onRocketLaunch(unit.get_id(), garrison, unit.get_location().get_map_location());
                     launchedWorkerCount += workerCount;
                 }
             }
@@ -11,4 +11,8 @@ struct BotRocket : BotUnit {
     void tick();
 };
 
-tuple<bool,MapLocation,int> find_best_landing_spot();
\ No newline at end of file
+tuple<bool,MapLocation,int> find_best_landing_spot();
+
+// Background job that computes the Mars karbonite forecast used by find_best_landing_spot next turn.
+// Returns an empty job if no rocket will need it.
+std::function<void()> speculateMarsKarbonite();
\ No newline at end of file
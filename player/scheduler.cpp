@@ -0,0 +1,145 @@
+#include "scheduler.h"
+#include "common.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <cassert>
+
+using namespace std;
+
+uint64_t checksumBytes(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+TaskScheduler::TaskScheduler() {
+    engineResource = addResource("engine", nullptr);
+}
+
+int TaskScheduler::addResource(const string& name, function<uint64_t()> checksum) {
+    assert(resources.size() < 64);
+    resources.push_back({ name, checksum });
+    return resources.size() - 1;
+}
+
+void TaskScheduler::addTask(const string& name, vector<int> reads, vector<int> writes, function<void()> run) {
+    Task task;
+    task.name = name;
+    task.reads = 0;
+    task.writes = 0;
+    for (int resource : reads) task.reads |= 1ULL << resource;
+    for (int resource : writes) task.writes |= 1ULL << resource;
+    task.run = run;
+    task.dependencyCount = 0;
+
+    int index = tasks.size();
+    for (int i = 0; i < index; i++) {
+        auto& other = tasks[i];
+        if ((other.writes & (task.reads | task.writes)) || (other.reads & task.writes)) {
+            other.dependents.push_back(index);
+            task.dependencyCount++;
+        }
+    }
+    tasks.push_back(task);
+}
+
+#ifndef NDEBUG
+void TaskScheduler::run(ThreadPool&) {
+    vector<uint64_t> before(resources.size());
+    for (auto& task : tasks) {
+        for (size_t i = 0; i < resources.size(); i++) {
+            if (resources[i].checksum) before[i] = resources[i].checksum();
+        }
+        task.run();
+        for (size_t i = 0; i < resources.size(); i++) {
+            if (!resources[i].checksum || ((task.writes >> i) & 1))
+                continue;
+            if (resources[i].checksum() != before[i]) {
+                cout << "Task " << task.name << " wrote " << resources[i].name << " without declaring it" << endl;
+            }
+        }
+    }
+}
+#else
+void TaskScheduler::run(ThreadPool& pool) {
+    if (pool.threadCount() == 0) {
+        for (auto& task : tasks) {
+            task.run();
+        }
+        return;
+    }
+
+    std::mutex mutex;
+    condition_variable changed;
+    vector<int> remainingDependencies(tasks.size());
+    vector<int> mainThreadQueue;
+    int remainingTasks = tasks.size();
+
+    // Must be called with the mutex held. Returns tasks that should be submitted to the pool.
+    auto release = [&](int index, vector<int>& toSubmit) {
+        if (onMainThread(tasks[index])) {
+            mainThreadQueue.push_back(index);
+        } else {
+            toSubmit.push_back(index);
+        }
+    };
+
+    function<void(int)> submit;
+    auto finish = [&](int index) {
+        vector<int> toSubmit;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            for (int dependent : tasks[index].dependents) {
+                if (--remainingDependencies[dependent] == 0) {
+                    release(dependent, toSubmit);
+                }
+            }
+            remainingTasks--;
+            // Notify while holding the lock, run may return as soon as remainingTasks reaches zero
+            changed.notify_all();
+        }
+        for (int next : toSubmit) {
+            submit(next);
+        }
+    };
+    submit = [&](int index) {
+        pool.submit([&, index] {
+            tasks[index].run();
+            finish(index);
+        });
+    };
+
+    vector<int> toSubmit;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < tasks.size(); i++) {
+            remainingDependencies[i] = tasks[i].dependencyCount;
+            if (remainingDependencies[i] == 0) {
+                release(i, toSubmit);
+            }
+        }
+    }
+    for (int next : toSubmit) {
+        submit(next);
+    }
+
+    while (true) {
+        int index;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return remainingTasks == 0 || !mainThreadQueue.empty(); });
+            if (mainThreadQueue.empty()) {
+                break;
+            }
+            index = mainThreadQueue.back();
+            mainThreadQueue.pop_back();
+        }
+        tasks[index].run();
+        finish(index);
+    }
+}
+#endif
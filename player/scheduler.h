@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "parallel.h"
+
+// Runs a fixed list of tasks where every task declares which resources (usually global maps) it reads and writes.
+// A task depends on every earlier task that writes something it reads or writes, or reads something it writes.
+// Independent tasks run in parallel on a thread pool.
+//
+// The game controller is modelled as the resource returned by engine().
+// Tasks that write it are always run on the calling thread, one at a time.
+//
+// In debug builds all tasks are run serially in the order they were added, and every resource
+// is checksummed before and after each task to catch writes that the task did not declare.
+struct TaskScheduler {
+    TaskScheduler();
+
+    // The checksum is only used in debug builds to detect undeclared writes, it may be null
+    int addResource(const std::string& name, std::function<uint64_t()> checksum);
+    void addTask(const std::string& name, std::vector<int> reads, std::vector<int> writes, std::function<void()> run);
+    void run(ThreadPool& pool);
+
+    int engine() const { return engineResource; }
+
+private:
+    struct Resource {
+        std::string name;
+        std::function<uint64_t()> checksum;
+    };
+
+    struct Task {
+        std::string name;
+        uint64_t reads;
+        uint64_t writes;
+        std::function<void()> run;
+        std::vector<int> dependents;
+        int dependencyCount;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Task> tasks;
+    int engineResource;
+
+    bool onMainThread(const Task& task) const {
+        return (task.writes >> engineResource) & 1;
+    }
+};
+
+// FNV-1a hash of a block of memory, useful for resource checksums
+uint64_t checksumBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL);
@@ -0,0 +1,131 @@
+#include "staticmaps.h"
+#include "maps.h"
+#include "gamecache.h"
+
+#include <queue>
+#include <assert.h>
+
+using namespace bc;
+using namespace std;
+
+PathfindingMap terrainCostMap;
+PathfindingMap initialEnemyProximityMap;
+vector<pii> initialEnemyPositions;
+
+static void computeTerrainMaps() {
+    passableTerrain = gameCache.terrainPassability(planet);
+    terrainCostMap = PathfindingMap(w, h);
+    for (int i = 0; i < w; i++) {
+        for (int j = 0; j < h; j++) {
+            if (passableTerrain.test(i, j)) {
+                terrainCostMap.weights[i][j] = 1.0;
+            }
+            else {
+                terrainCostMap.weights[i][j] = numeric_limits<double>::infinity();
+            }
+        }
+    }
+}
+
+static void computeInitialEnemyMaps() {
+    initialEnemyPositions.clear();
+    initialEnemyProximityMap = PathfindingMap(w, h);
+    if (planet != Earth) {
+        return;
+    }
+
+    for (auto& unit : gameCache.initialUnits(Earth)) {
+        if (!unit.get_location().is_on_map())
+            continue;
+        if (unit.get_team() == enemyTeam) {
+            auto pos = unit.get_location().get_map_location();
+            initialEnemyPositions.push_back(pii(pos.get_x(), pos.get_y()));
+            for (int x = 0; x < w; ++x) {
+                for (int y = 0; y < h; ++y) {
+                    int dx = pos.get_x() - x;
+                    int dy = pos.get_y() - y;
+                    initialEnemyProximityMap.weights[x][y] += 0.01 / (dx * dx + dy * dy + 5);
+                }
+            }
+        }
+    }
+}
+
+static void computeOurStartingPositionMap() {
+    ourStartingPositionMap = PathfindingMap(w, h);
+    if (planet == Earth) {
+        auto& initial_units = gameCache.initialUnits(Earth);
+        for (auto& unit : initial_units) {
+            if (!unit.get_location().is_on_map())
+                continue;
+            if (unit.get_team() == ourTeam) {
+                auto pos = unit.get_location().get_map_location();
+                for (int x = 0; x < w; ++x) {
+                    for (int y = 0; y < h; ++y) {
+                        int dx = pos.get_x() - x;
+                        int dy = pos.get_y() - y;
+                        ourStartingPositionMap.weights[x][y] = max(ourStartingPositionMap.weights[x][y], 200.0 / (dx * dx + dy * dy + 200.0));
+                    }
+                }
+            }
+        }
+    }
+    else {
+        ourStartingPositionMap += 1;
+    }
+}
+
+static void computeDistancesToInitialLocations() {
+    assert(planet == Earth);
+    auto& initial_units = gameCache.initialUnits(Earth);
+    for (int team = 0; team < 2; ++team) {
+        distanceToInitialLocation[team] = PathfindingMap(w, h);
+        distanceToInitialLocation[team] += 1000;
+        queue<pair<int, int> > bfsQueue;
+        for (auto& unit : initial_units) {
+            if (!unit.get_location().is_on_map())
+                continue;
+            if (unit.get_team() == team) {
+                auto pos = unit.get_location().get_map_location();
+                int x = pos.get_x();
+                int y = pos.get_y();
+                distanceToInitialLocation[team].weights[x][y] = 0;
+                bfsQueue.push(make_pair(x, y));
+
+            }
+        }
+        while(!bfsQueue.empty()) {
+            auto cur = bfsQueue.front();
+            bfsQueue.pop();
+            int x = cur.first;
+            int y = cur.second;
+            if (team == 1) {
+                initialDistanceToEnemyLocation = min(initialDistanceToEnemyLocation, (int)(distanceToInitialLocation[0].weights[x][y] + distanceToInitialLocation[1].weights[x][y]));
+            }
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                        continue;
+                    if (!passableTerrain.test(nx, ny))
+                        continue;
+                    int newDis = distanceToInitialLocation[team].weights[x][y] + 1;
+                    if (newDis < distanceToInitialLocation[team].weights[nx][ny]) {
+                        distanceToInitialLocation[team].weights[nx][ny] = newDis;
+                        bfsQueue.push(make_pair(nx, ny));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void initStaticMaps() {
+    computeTerrainMaps();
+    computeInitialEnemyMaps();
+    computeOurStartingPositionMap();
+    if (planet == Earth) {
+        computeDistancesToInitialLocations();
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common.h"
+#include "pathfinding.hpp"
+
+// Map layers that only depend on the initial map.
+// They are computed once at startup by initStaticMaps and the per-turn maps
+// are built on top of them instead of recomputing them every turn.
+// ourStartingPositionMap, distanceToInitialLocation and passableTerrain (see maps.h) are also computed here.
+
+// 1 on passable terrain and infinity on walls
+extern PathfindingMap terrainCostMap;
+// Sum of 0.01/(d^2 + 5) over all initial enemy units. Only non-zero on Earth.
+extern PathfindingMap initialEnemyProximityMap;
+// Positions of the initial enemy units. Empty on Mars.
+extern std::vector<pii> initialEnemyPositions;
+
+void initStaticMaps();
@@ -0,0 +1,139 @@
+#include "timebudget.h"
+#include "common.h"
+
+#include <cmath>
+
+using namespace std;
+
+TimeBudget timeBudget;
+
+// The engine adds this much to the time bank every turn
+static const double TURN_INCREMENT_MS = 50;
+// Never plan to use this part of the bank, it is the margin that keeps us from timing out
+static const double RESERVE_MS = 2000;
+static const int LAST_ROUND = 1000;
+// The deadline is this many times the turn target...
+static const double DEADLINE_TARGET_FACTOR = 4;
+// ...but at least this long, so that ordinary spikes are not cut short...
+static const double MIN_DEADLINE_MS = 250;
+// ...and at most this fraction of the bank
+static const double MAX_DEADLINE_BANK_FRACTION = 0.25;
+// Qualities below this are not used to update the cost estimates, the phase has mostly been skipped
+static const double MIN_MEASURED_QUALITY = 0.25;
+// The estimate of a phase that got too little time to be measured decays by this factor every turn,
+// so that it is eventually planned again instead of being starved for the rest of the game
+static const double STARVED_DECAY = 0.95;
+// A phase that has been starved this many turns in a row gets its full expected cost once,
+// if the bank has at least PROBE_BANK_FACTOR times that to spare
+static const int PROBE_INTERVAL = 10;
+static const double PROBE_BANK_FACTOR = 20;
+// Every phase is planned at least this fraction of the turn target before the rest is handed out by priority.
+// The phases before coordination do not shrink with quality, so without it coordination gets nothing in every large fight.
+static const double minShare[NUM_TIME_PHASES] = { 0, 0, 0.2, 0 };
+
+// Whether the work a phase does actually shrinks with its quality.
+// The units tick and the maps are updated regardless, so for those the measured time is the full cost.
+static const bool scalesWithQuality[NUM_TIME_PHASES] = { false, false, true, true };
+
+static const char* phaseNames[NUM_TIME_PHASES] = { "maps", "ticks", "coordination", "matching" };
+
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void TimeBudget::startTurn(int timeLeftMs, int round) {
+    turnStart = chrono::steady_clock::now();
+    timeLeft = timeLeftMs;
+    int roundsLeft = max(1, LAST_ROUND - round + 1);
+    double spendable = max(0.0, timeLeftMs - RESERVE_MS);
+    turnTarget = min(TURN_INCREMENT_MS + spendable / roundsLeft, spendable);
+
+    double reserved[NUM_TIME_PHASES];
+    double remaining = turnTarget;
+    for (int i = 0; i < NUM_TIME_PHASES; i++) {
+        reserved[i] = min(minShare[i] * turnTarget, remaining);
+        remaining -= reserved[i];
+    }
+
+    for (int i = 0; i < NUM_TIME_PHASES; i++) {
+        used[i] = 0;
+        remaining += reserved[i];
+        if (expectedCost[i] <= 0) {
+            // No estimate yet, let the phase run and measure it
+            planned[i] = remaining;
+            qualities[i] = 1;
+            continue;
+        }
+        planned[i] = min(expectedCost[i], remaining);
+        qualities[i] = planned[i] / expectedCost[i];
+        remaining -= planned[i];
+
+        if (qualities[i] >= MIN_MEASURED_QUALITY) {
+            starvedTurns[i] = 0;
+        }
+        else if (++starvedTurns[i] >= PROBE_INTERVAL && spendable >= expectedCost[i] * PROBE_BANK_FACTOR) {
+            // Probe, which also measures what the phase costs now
+            planned[i] = expectedCost[i];
+            qualities[i] = 1;
+            starvedTurns[i] = 0;
+        }
+    }
+}
+
+void TimeBudget::endTurn() {
+    turnTime = millisSince(turnStart);
+    turns++;
+    if (turnTime > turnTarget) {
+        turnsOverTarget++;
+    }
+
+    const double interpolationFactor = 0.7;
+    for (int i = 0; i < NUM_TIME_PHASES; i++) {
+        double fullCost = used[i];
+        if (scalesWithQuality[i]) {
+            if (qualities[i] < MIN_MEASURED_QUALITY) {
+                expectedCost[i] *= STARVED_DECAY;
+                continue;
+            }
+            fullCost /= qualities[i];
+        }
+        if (expectedCost[i] <= 0) {
+            expectedCost[i] = fullCost;
+        }
+        else {
+            expectedCost[i] = expectedCost[i] * interpolationFactor + fullCost * (1 - interpolationFactor);
+        }
+    }
+}
+
+double TimeBudget::deadline() const {
+    double deadline = max(DEADLINE_TARGET_FACTOR * turnTarget, MIN_DEADLINE_MS);
+    return max(TURN_INCREMENT_MS, min(deadline, timeLeft * MAX_DEADLINE_BANK_FRACTION));
+}
+
+bool TimeBudget::overBudget(TimePhase phase) const {
+    int i = (int)phase;
+    double total = used[i];
+    if (running[i]) {
+        total += millisSince(runningSince[i]);
+    }
+    return total >= planned[i];
+}
+
+TimeBudget::Scope::Scope(TimeBudget& budget, TimePhase phase) : budget(budget), phase(phase), start(chrono::steady_clock::now()) {
+    budget.running[(int)phase] = true;
+    budget.runningSince[(int)phase] = start;
+}
+
+TimeBudget::Scope::~Scope() {
+    budget.running[(int)phase] = false;
+    budget.used[(int)phase] += millisSince(start);
+}
+
+void TimeBudget::printStats() const {
+    cout << "Time budget: target " << std::round(turnTarget) << " ms, used " << std::round(turnTime) << " ms";
+    cout << " (over target in " << turnsOverTarget << "/" << turns << " turns)" << endl;
+    for (int i = 0; i < NUM_TIME_PHASES; i++) {
+        cout << "   " << phaseNames[i] << ": quality " << qualities[i] << ", planned " << std::round(planned[i]) << " ms, used " << std::round(used[i]) << " ms" << endl;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+
+// Parts of the turn that the time budget is split between, in priority order
+enum class TimePhase { Maps, Ticks, Coordination, Matching };
+const int NUM_TIME_PHASES = 4;
+
+// Decides how much time each turn may use and how that time is split between the phases of the turn.
+//
+// The turn target is the time the engine adds to the bank every turn plus an even share of what is left
+// of the bank (minus a reserve) over the remaining rounds, so time saved in cheap turns is spent later.
+// The target is handed out to the phases in priority order based on what each phase cost at full quality
+// in earlier turns, after every phase has been given its minimum share. A phase that only gets part of what it
+// needs gets a quality below 1 and should scale down its effort accordingly, instead of everything being
+// switched off at once when the bank runs low.
+// Phases that were starved for a while are given their full expected cost once (if the bank allows it),
+// so that a phase is never switched off for the rest of the game just because its estimate is out of date.
+//
+// Times are measured in wall clock time since that is what the engine charges us for.
+struct TimeBudget {
+    // Call at the start of the turn
+    void startTurn(int timeLeftMs, int round);
+    // Call at the end of the turn, updates the cost estimates
+    void endTurn();
+
+    // Time after which the turn should be cut short, in milliseconds since the start of the turn.
+    // A few times the turn target, but never so much that a single turn can use up a large part of the bank.
+    double deadline() const;
+
+    // How much effort the phase should spend this turn, between 0 and 1
+    double quality(TimePhase phase) const { return qualities[(int)phase]; }
+    // True if the phase has used all the time planned for it this turn, including a scope that is still running
+    bool overBudget(TimePhase phase) const;
+
+    // Adds the time until the scope ends to the phase
+    struct Scope {
+        Scope(TimeBudget& budget, TimePhase phase);
+        ~Scope();
+
+    private:
+        TimeBudget& budget;
+        TimePhase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void printStats() const;
+
+    double turnTarget = 0;
+    double planned[NUM_TIME_PHASES] = {};
+    double used[NUM_TIME_PHASES] = {};
+
+private:
+    double qualities[NUM_TIME_PHASES] = { 1, 1, 1, 1 };
+    bool running[NUM_TIME_PHASES] = {};
+    std::chrono::steady_clock::time_point runningSince[NUM_TIME_PHASES];
+    // Moving average of what each phase costs at full quality
+    double expectedCost[NUM_TIME_PHASES] = {};
+    // Turns in a row that the phase got too little time to be measured
+    int starvedTurns[NUM_TIME_PHASES] = {};
+    std::chrono::steady_clock::time_point turnStart;
+    double turnTime = 0;
+    double timeLeft = 0;
+    int turnsOverTarget = 0;
+    int turns = 0;
+};
+
+extern TimeBudget timeBudget;
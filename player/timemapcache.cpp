@@ -0,0 +1,73 @@
+#include "timemapcache.h"
+
+#include <cmath>
+
+using namespace std;
+
+TimeMapCache timeMapCache;
+
+TimeMap::TimeMap(const vector<vector<double> >& distances) {
+    int w = distances.size();
+    h = w == 0 ? 0 : distances[0].size();
+    times.resize(w * h);
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) {
+            double time = distances[x][y];
+            times[x * h + y] = isinf(time) ? UNREACHABLE : (uint16_t)min(std::round(time), UNREACHABLE - 1.0);
+        }
+    }
+}
+
+const TimeMap* TimeMapCache::find(pii pos, uint64_t version) {
+    auto it = entries.find(pos);
+    if (it == entries.end() || it->second.version != version) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    auto& entry = it->second;
+    entry.generation = generation;
+    recency.splice(recency.begin(), recency, entry.recency);
+    return &entry.map;
+}
+
+bool TimeMapCache::contains(pii pos, uint64_t version) const {
+    auto it = entries.find(pos);
+    return it != entries.end() && it->second.version == version;
+}
+
+const TimeMap* TimeMapCache::insert(pii pos, uint64_t version, TimeMap map) {
+    auto it = entries.find(pos);
+    if (it == entries.end()) {
+        recency.push_front(pos);
+        it = entries.insert(make_pair(pos, Entry { TimeMap(), 0, 0, recency.begin() })).first;
+    } else {
+        // Replaces a stale entry
+        bytes -= it->second.map.bytes();
+        recency.splice(recency.begin(), recency, it->second.recency);
+    }
+    auto& entry = it->second;
+    entry.map = move(map);
+    entry.version = version;
+    entry.generation = generation;
+    bytes += entry.map.bytes();
+    evict();
+    return &entry.map;
+}
+
+void TimeMapCache::evict() {
+    while (bytes > maxBytes && !recency.empty()) {
+        auto it = entries.find(recency.back());
+        // The least recently used entry is in use, so all of them are
+        if (it->second.generation == generation) break;
+        bytes -= it->second.map.bytes();
+        entries.erase(it);
+        recency.pop_back();
+        evictions++;
+    }
+}
+
+void TimeMapCache::printStats() const {
+    cout << "Time map cache: " << entries.size() << " maps, " << bytes / 1024 << " kB, ";
+    cout << hits << " hits, " << misses << " misses, " << evictions << " evictions" << endl;
+}
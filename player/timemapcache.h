@@ -0,0 +1,72 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <cstdint>
+#include <limits>
+
+#include "common.h"
+
+// Turns a worker needs to get from one tile to every other tile, stored compactly.
+// The times are whole turns, which fit in 16 bits on any map.
+struct TimeMap {
+    static const uint16_t UNREACHABLE = 0xFFFF;
+
+    TimeMap() {}
+    // From the result of a Dijkstra search, infinite distances are unreachable
+    explicit TimeMap(const std::vector<std::vector<double> >& distances);
+
+    // Infinite if the tile cannot be reached
+    double at(int x, int y) const {
+        uint16_t time = times[x * h + y];
+        return time == UNREACHABLE ? std::numeric_limits<double>::infinity() : time;
+    }
+
+    size_t bytes() const { return times.size() * sizeof(uint16_t); }
+
+private:
+    int h = 0;
+    std::vector<uint16_t> times;
+};
+
+// Time maps by the tile they were computed from, with least recently used eviction once they take up more than maxBytes.
+//
+// Every entry is stamped with the version of the cost map it was computed from (e.g. a checksum of it),
+// entries with another version are treated as missing and replaced.
+// Entries used during the current generation are never evicted, so the pointers returned by find stay valid
+// until the next call to newGeneration. The cache can therefore go over maxBytes for a while if one generation uses many maps.
+struct TimeMapCache {
+    size_t maxBytes = 4 << 20;
+
+    // Call before a batch of lookups whose results are used together
+    void newGeneration() { generation++; }
+    // The cached map, or null if there is none for this version. Counts as a use.
+    const TimeMap* find(pii pos, uint64_t version);
+    // Like find but neither counts as a use nor changes the statistics
+    bool contains(pii pos, uint64_t version) const;
+    const TimeMap* insert(pii pos, uint64_t version, TimeMap map);
+
+    int hits = 0;
+    int misses = 0;
+    int evictions = 0;
+    size_t bytes = 0;
+
+    void printStats() const;
+
+private:
+    struct Entry {
+        TimeMap map;
+        uint64_t version;
+        int generation;
+        // Position in the recency list
+        std::list<pii>::iterator recency;
+    };
+    std::map<pii, Entry> entries;
+    // Most recently used first
+    std::list<pii> recency;
+    int generation = 0;
+
+    void evict();
+};
+
+extern TimeMapCache timeMapCache;
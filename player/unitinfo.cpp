@@ -0,0 +1,129 @@
+#include "unitinfo.h"
+
+#include <unordered_map>
+
+using namespace bc;
+using namespace std;
+
+static vector<UnitInfo> unitInfos;
+static unordered_map<unsigned int, int> unitInfoIndex;
+// Index in unitInfos of the unit standing on each tile
+static int unitInfoAt[MAX_MAP_SIZE][MAX_MAP_SIZE];
+static Bitboard unitInfoOccupancy;
+
+static thread_local vector<UnitInfo> nearbyUnitsBuffer;
+
+vector<UnitInfo> ourUnitInfos;
+vector<UnitInfo> enemyUnitInfos;
+
+static void removeFromTile(const UnitInfo& info) {
+    if (unitInfoAt[info.x][info.y] == unitInfoIndex[info.id]) {
+        unitInfoAt[info.x][info.y] = -1;
+        unitInfoOccupancy.reset(info.x, info.y);
+    }
+}
+
+void buildUnitInfos() {
+    unitInfos.clear();
+    unitInfoIndex.clear();
+    unitInfoOccupancy.clear();
+    for (auto& unit : allUnits) {
+        updateUnitInfo(unit);
+    }
+
+    ourUnitInfos.clear();
+    enemyUnitInfos.clear();
+    for (auto& unit : allUnits) {
+        auto it = unitInfoIndex.find(unit.get_id());
+        if (it != unitInfoIndex.end()) {
+            const auto& info = unitInfos[it->second];
+            (info.team == ourTeam ? ourUnitInfos : enemyUnitInfos).push_back(info);
+        }
+    }
+}
+
+void updateUnitInfo(const Unit& unit) {
+    if (!unit.get_location().is_on_map()) {
+        removeUnitInfo(unit.get_id());
+        return;
+    }
+    const auto location = unit.get_location().get_map_location();
+    if (location.get_planet() != planet) {
+        removeUnitInfo(unit.get_id());
+        return;
+    }
+
+    int index;
+    auto it = unitInfoIndex.find(unit.get_id());
+    if (it != unitInfoIndex.end()) {
+        index = it->second;
+        removeFromTile(unitInfos[index]);
+    } else {
+        index = unitInfos.size();
+        unitInfos.push_back(UnitInfo());
+        unitInfoIndex[unit.get_id()] = index;
+    }
+
+    auto& info = unitInfos[index];
+    info.id = unit.get_id();
+    info.team = unit.get_team();
+    info.type = unit.get_unit_type();
+    info.x = location.get_x();
+    info.y = location.get_y();
+    info.health = unit.get_health();
+    info.maxHealth = unit.get_max_health();
+    info.built = !is_structure(info.type) || unit.structure_is_built();
+    unitInfoAt[info.x][info.y] = index;
+    unitInfoOccupancy.set(info.x, info.y);
+}
+
+void removeUnitInfo(unsigned int id) {
+    auto it = unitInfoIndex.find(id);
+    if (it == unitInfoIndex.end()) {
+        return;
+    }
+    // Leave the entry in place so that the indices of the other units stay valid.
+    // It is no longer reachable from the tile grid.
+    auto& info = unitInfos[it->second];
+    removeFromTile(info);
+    info.health = 0;
+    unitInfoIndex.erase(it);
+}
+
+void resyncEnemyUnitInfoAt(int x, int y) {
+    if (x < 0 || y < 0 || x >= w || y >= h || !unitInfoOccupancy.test(x, y)) {
+        return;
+    }
+    const auto& info = unitInfos[unitInfoAt[x][y]];
+    if (info.team == ourTeam) {
+        return;
+    }
+    unsigned int id = info.id;
+    if (gc.can_sense_unit(id)) {
+        updateUnitInfo(gc.get_unit(id));
+    } else {
+        removeUnitInfo(id);
+    }
+}
+
+NearbyUnits senseNearbyUnits(const MapLocation& location, int squaredRadius) {
+    nearbyUnitsBuffer.clear();
+    int x = location.get_x();
+    int y = location.get_y();
+    int r;
+    for (r = 0; (r+1)*(r+1) <= squaredRadius; ++r);
+    for (int dx = -r; dx <= r; ++dx) {
+        int nx = x + dx;
+        if (nx < 0 || nx >= w)
+            continue;
+        int k;
+        for (k = 0; dx*dx + (k+1)*(k+1) <= squaredRadius; ++k);
+        uint64_t column = unitInfoOccupancy.bits[nx] & Bitboard::rangeMask(y - k, y + k);
+        while (column != 0) {
+            int ny = __builtin_ctzll(column);
+            column &= column - 1;
+            nearbyUnitsBuffer.push_back(unitInfos[unitInfoAt[nx][ny]]);
+        }
+    }
+    return NearbyUnits { nearbyUnitsBuffer };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "common.h"
+#include "bitboard.hpp"
+
+// Plain copy of the unit fields that the combat code needs.
+// Reading a field from a bc::Unit goes through the FFI, and every unit returned
+// by gc.sense_nearby_units is a separate allocation on the engine side that has to be copied out and freed again.
+// The accessors are named like the bc::Unit ones so that loops over nearby units keep their shape.
+struct UnitInfo {
+    unsigned int id;
+    bc::Team team;
+    bc::UnitType type;
+    int x;
+    int y;
+    unsigned int health;
+    unsigned int maxHealth;
+    bool built;
+
+    unsigned int get_id() const { return id; }
+    bc::Team get_team() const { return team; }
+    bc::UnitType get_unit_type() const { return type; }
+    unsigned int get_health() const { return health; }
+    unsigned int get_max_health() const { return maxHealth; }
+    bool is_robot() const { return bc::is_robot(type); }
+    bool structure_is_built() const { return built; }
+    int get_x() const { return x; }
+    int get_y() const { return y; }
+    bc::MapLocation get_map_location() const { return bc::MapLocation(planet, x, y); }
+};
+
+// Units returned by senseNearbyUnits.
+// Refers to a per-thread buffer which is only valid until the next call to senseNearbyUnits on the same thread.
+struct NearbyUnits {
+    const std::vector<UnitInfo>& units;
+
+    std::vector<UnitInfo>::const_iterator begin() const { return units.begin(); }
+    std::vector<UnitInfo>::const_iterator end() const { return units.end(); }
+    size_t size() const { return units.size(); }
+};
+
+// Our and the enemy's units on the map at the start of the turn, in the same order as ourUnits and enemyUnits.
+// Not updated during the turn. Safe to read from worker threads.
+extern std::vector<UnitInfo> ourUnitInfos;
+extern std::vector<UnitInfo> enemyUnitInfos;
+
+// Rebuild the snapshot of all units on the map from allUnits. Called by findUnits.
+void buildUnitInfos();
+// Update the snapshot of a single unit
+void updateUnitInfo(const bc::Unit& unit);
+void removeUnitInfo(unsigned int id);
+// Re-read the enemy unit (if any) on a tile from the engine, e.g after it has been attacked.
+// Our units are re-synced through invalidate_unit instead.
+void resyncEnemyUnitInfoAt(int x, int y);
+
+// Local replacement for gc.sense_nearby_units, only knows about units that we can see
+NearbyUnits senseNearbyUnits(const bc::MapLocation& location, int squaredRadius);
@@ -0,0 +1,89 @@
+#include "vision.h"
+
+#include <assert.h>
+
+using namespace bc;
+using namespace std;
+
+Bitboard canSenseLocation;
+
+// Number of our units that can see each tile.
+// Makes it possible to remove the vision of a single unit when it moves.
+// Every unit that is removed must have been added, so the counts are rebuilt whenever findUnits picks up new units.
+static int visionCount[MAX_MAP_SIZE][MAX_MAP_SIZE];
+
+// Vision discs for each squared vision range.
+// Element dx+r is the half height of the disc in the column dx tiles away from the center.
+static map<unsigned int, vector<int> > visionDiscs;
+
+static const vector<int>& getVisionDisc(unsigned int squaredRadius) {
+    auto it = visionDiscs.find(squaredRadius);
+    if (it != visionDiscs.end()) {
+        return it->second;
+    }
+
+    int r;
+    for (r = 0; (r+1)*(r+1) <= (int)squaredRadius; ++r);
+    vector<int> disc(2*r+1);
+    for (int dx = -r; dx <= r; ++dx) {
+        int k;
+        for (k = 0; dx*dx + (k+1)*(k+1) <= (int)squaredRadius; ++k);
+        disc[dx+r] = k;
+    }
+    return visionDiscs[squaredRadius] = disc;
+}
+
+static void changeVision(const Unit& unit, int delta) {
+    if (!unit.get_location().is_on_map()) {
+        return;
+    }
+    const auto location = unit.get_location().get_map_location();
+    const auto& disc = getVisionDisc(unit.get_vision_range());
+    int r = disc.size() / 2;
+    int x0 = location.get_x();
+    int y0 = location.get_y();
+    for (int dx = -r; dx <= r; ++dx) {
+        int x = x0 + dx;
+        if (x < 0 || x >= w)
+            continue;
+        int ymin = max(0, y0 - disc[dx+r]);
+        int ymax = min(h - 1, y0 + disc[dx+r]);
+        for (int y = ymin; y <= ymax; ++y) {
+            visionCount[x][y] += delta;
+            assert(visionCount[x][y] >= 0);
+            canSenseLocation.set(x, y, visionCount[x][y] > 0);
+        }
+    }
+}
+
+void addVision(const Unit& unit) {
+    changeVision(unit, 1);
+}
+
+void removeVision(const Unit& unit) {
+    changeVision(unit, -1);
+}
+
+void updateCanSenseLocation() {
+    canSenseLocation.clear();
+    for (int x = 0; x < MAX_MAP_SIZE; ++x) {
+        fill(visionCount[x], visionCount[x] + MAX_MAP_SIZE, 0);
+    }
+    for (auto& unit : ourUnits) {
+        addVision(unit);
+    }
+
+#ifndef NDEBUG
+    int mismatches = 0;
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) {
+            if (canSenseLocation.test(x, y) != gc.can_sense_location(MapLocation(planet, x, y))) {
+                mismatches++;
+            }
+        }
+    }
+    if (mismatches) {
+        cout << "Vision mismatch on " << mismatches << " tiles" << endl;
+    }
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.h"
+#include "bitboard.hpp"
+
+// Tiles that we can currently see.
+// Computed locally from the vision ranges of our units instead of asking the engine about every tile.
+extern Bitboard canSenseLocation;
+
+void updateCanSenseLocation();
+void addVision(const bc::Unit& unit);
+void removeVision(const bc::Unit& unit);
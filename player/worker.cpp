@@ -1,8 +1,17 @@
 #include "worker.h"
 #include "pathfinding.hpp"
 #include "view.hpp"
-#include "hungarian.h"
+#include "lap.h"
 #include "maps.h"
+#include "vision.h"
+#include "gamecache.h"
+#include "karbonite.h"
+#include "scheduler.h"
+#include "timebudget.h"
+#include "timemapcache.h"
+#include "unitinfo.h"
+
+#include <sstream>
 
 using namespace bc;
 using namespace std;
@@ -13,116 +22,187 @@ int repairSpeed = 10;
 int debugRound = -1;
 bool devsFixedReplicationBug = false;
 
-struct KarboniteGroup {
-    vector<pii> tiles;
-    int totalValue;
-};
-
-vector<KarboniteGroup> groupKarbonite() {
-    vector<vector<bool>> covered(w, vector<bool>(h));
-    vector<vector<int>> groupIndices(w, vector<int>(h, -1));
-    int maxTimeCostPerGroup = 30;
-    vector<KarboniteGroup> groups;
+// Prints the karbonite groups, first with the karbonite on every tile and then with the group indices
+void printKarboniteGroups() {
+    print({ 0, 0, w - 1, h - 1 }, colorsByID([&](int x, int y) { return karboniteClusters.groupAt(x, y) + 1; }), labels([&](int x, int y) { return (int)karboniteMap.weights[x][y]; }));
+    print({ 0, 0, w - 1, h - 1 }, colorsByID([&](int x, int y) { return karboniteClusters.groupAt(x, y) + 1; }), labels([&](int x, int y) { return max(0, karboniteClusters.groupAt(x, y)); }));
+}
 
+// Workers take approximately 2 ticks to move one tile
+// TODO: Can optimize to simply 2 times BFS-distance
+PathfindingMap workerTimeCostMap() {
+    PathfindingMap timeCost(w, h);
+    timeCost += 2;
     for (int x = 0; x < w; x++) {
         for (int y = 0; y < h; y++) {
-            if (covered[x][y] || karboniteMap.weights[x][y] <= 0) continue;
-
-            KarboniteGroup group;
-            queue<pii> que1;
-            queue<pii> que2;
-            que1.push(pii(x, y));
-            int timeCost = 0;
-            vector<vector<bool>> covered2(w, vector<bool>(h));
-            covered2[x][y] = true;
-
-            while(timeCost < maxTimeCostPerGroup) {
-                if (que1.empty()) {
-                    swap(que1, que2);
-                }
-                if (que1.empty()) break;
-
-                int timeToMine = (karboniteMap.weights[x][y] + (miningSpeed-1)) / miningSpeed;
-                // Workers can move every second turn so we will have to spend at least 2 turns here
-                timeToMine = max(timeToMine, 2);
-                timeCost += timeToMine;
-                
-                pii p = que1.front();
-                que1.pop();
-                group.tiles.push_back(p);
-                covered[p.first][p.second] = true;
-                groupIndices[p.first][p.second] = groups.size();
-
-                for (int dx = -1; dx <= 1; dx++) {
-                    for (int dy = -1; dy <= 1; dy++) {
-                        int nx = p.first + dx;
-                        int ny = p.second + dy;
-                        if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
-                        if (covered2[nx][ny] || covered[nx][ny]) continue;
-
-                        // TODO: What about karbonite inside walls? That can be mined in some cases
-                        if (isinf(passableMap.weights[nx][ny])) continue;
-
-                        covered2[nx][ny] = true;
-
-                        // Try to avoid adding non-karbonite tiles to the group if possible
-                        if (karboniteMap.weights[nx][ny] == 0) {
-                            que2.push(pii(nx,ny));
-                        } else {
-                            que1.push(pii(nx,ny));
-                        }
-                    }
-                }
-            }
-
-            groups.push_back(group);
+            if (isinf(passableMap.weights[x][y])) timeCost.weights[x][y] = passableMap.weights[x][y];
         }
     }
+    return timeCost;
+}
 
-    if ((int)gc.get_round() == debugRound) {
-        print({ 0, 0, w - 1, h - 1 }, colorsByID([&](int x, int y) { return groupIndices[x][y] + 1; }), labels([&](int x, int y) { return (int)karboniteMap.weights[x][y]; }));
-        print({ 0, 0, w - 1, h - 1 }, colorsByID([&](int x, int y) { return groupIndices[x][y] + 1; }), labels([&](int x, int y) { return max(0, groupIndices[x][y]); }));
+uint64_t checksumTimeCost(const PathfindingMap& timeCost) {
+    uint64_t hash = checksumBytes(nullptr, 0);
+    for (auto& column : timeCost.weights) {
+        hash = checksumBytes(column.data(), column.size() * sizeof(double), hash);
     }
-
-    return groups;
+    return hash;
 }
 
-double greedyWeightedMatching(vector<vector<double>>& costs, vector<int>& assignment) {
-    assignment.resize(costs.size());
-    vector<tuple<double,int,int>> costOrder;
-    vector<bool> usedTargets(costs[0].size());
-    for (int i = 0; i < (int)costs.size(); i++) {
-        assignment[i] = -1;
+// Time maps computed in the background for tiles that workers are likely to be on next turn.
+// Only used if they were computed from the same time cost map.
+uint64_t speculativeTimeMapsKey;
+map<pair<int, int>, TimeMap> speculativeTimeMaps;
+int speculativeTimeMapHits;
+
+function<void()> speculateWorkerTimeMaps(const BackgroundTask& task) {
+    speculativeTimeMaps.clear();
+    if (planet != Earth) return nullptr;
+
+    auto timeCost = workerTimeCostMap();
+    speculativeTimeMapsKey = checksumTimeCost(timeCost);
+
+    vector<pair<int, int>> positions;
+    Bitboard added;
+    for (auto& u : ourUnits) {
+        if (u.get_unit_type() != Worker || !u.get_location().is_on_map()) continue;
+        auto pos = u.get_location().get_map_location();
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                int x = pos.get_x() + dx;
+                int y = pos.get_y() + dy;
+                if (x < 0 || y < 0 || x >= w || y >= h || !passableTerrain.test(x, y)) continue;
+                auto key = make_pair(x, y);
+                if (added.test(x, y) || timeMapCache.contains(key, speculativeTimeMapsKey)) continue;
+                added.set(x, y);
+                positions.push_back(key);
+            }
+        }
+    }
+    if (positions.empty()) return nullptr;
+
+    return [&task, positions, timeCost] {
+        Pathfinder pathfinder;
+        for (auto& pos : positions) {
+            if (task.cancelled()) return;
+            speculativeTimeMaps[pos] = TimeMap(pathfinder.getDistanceToAllTiles(pos.first, pos.second, timeCost));
+        }
+    };
+}
 
-        for (int j = 0; j < (int)costs[i].size(); j++) {
-            costOrder.push_back(make_tuple(costs[i][j], i, j));
+// Capacity of structures in the worker matching
+static const int MAX_WORKERS_PER_STRUCTURE = 8;
+// Candidates per worker and target used even when the matching has very little time
+static const int MIN_WORKER_MATCHING_CANDIDATES = 4;
+int workerMatchingCandidates = 12;
+
+// Kept between turns, the matching is warm started from the previous one
+LapSolver workerMatcher;
+int matchingAugmentations;
+
+// Target a worker was matched to, kept so that the matching can be reused on turns that have no time for it.
+// Groups and structures are indexed differently every turn, so the targets are remembered by location.
+struct WorkerTarget {
+    int x, y;
+    bool structure;
+};
+map<unsigned, WorkerTarget> previousWorkerTargets;
+int previousWorkerTargetsRound = -1;
+// Older matchings are not reused
+static const int MAX_WORKER_TARGET_AGE = 5;
+
+// Tiles the worker should move towards to reach the target
+PathfindingMap workerTargetMask(const WorkerTarget& target, const vector<KarboniteGroup>& groups) {
+    PathfindingMap mask(w, h);
+    if (target.structure) {
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                int nx = target.x + dx;
+                int ny = target.y + dy;
+                if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                mask.weights[nx][ny] = 1;
+            }
+        }
+    } else {
+        for (auto p : groups[karboniteClusters.groupAt(target.x, target.y)].tiles) {
+            mask.weights[p.first][p.second] = 1;
         }
     }
-    double totalCost = 0;
-    sort(costOrder.begin(), costOrder.end());
-    for (auto tup : costOrder) {
-        double cost;
-        int i, j;
-        tie(cost, i, j) = tup;
+    return mask;
+}
 
-        if (assignment[i] != -1 || usedTargets[j]) continue;
+// Gives every worker the target it was matched to on an earlier turn, if that target is still there.
+// Workers without one use their original target map.
+void reusePreviousWorkerTargets(const vector<BotWorker*>& workers, const vector<KarboniteGroup>& groups, const vector<Unit*>& unitTargets) {
+    bool recent = previousWorkerTargetsRound >= (int)gc.get_round() - MAX_WORKER_TARGET_AGE;
+    for (auto* worker : workers) {
+        worker->calculatedTargetMap = PathfindingMap();
+        auto it = previousWorkerTargets.find(worker->id);
+        if (!recent || it == previousWorkerTargets.end()) continue;
+
+        auto& target = it->second;
+        bool exists = false;
+        if (target.structure) {
+            for (auto* u : unitTargets) {
+                auto pos = u->get_map_location();
+                exists |= pos.get_x() == target.x && pos.get_y() == target.y;
+            }
+        } else {
+            exists = karboniteClusters.groupAt(target.x, target.y) != -1;
+        }
 
-        usedTargets[j] = true;
-        assignment[i] = j;
-        totalCost += cost;
+        if (exists) {
+            worker->calculatedTargetMap = workerTargetMask(target, groups) * worker->getOriginalTargetMap();
+        }
     }
-    return totalCost;
 }
 
-map<pair<int, int>, vector<vector<double> > > cachedTimeMaps;
+// Picks the pairs of workers and targets the matching considers: the numCandidates best targets of every worker
+// and the numCandidates best workers of every target. Pairs are ranked by an upper bound on their score,
+// the value of the best tile of the target divided by the least cost a path to the target can have,
+// so that the distance maps only have to be computed as far as the candidates.
+// Targets the worker cannot reach at all are never candidates.
+vector<vector<int>> selectMatchingCandidates(const vector<pii>& workerPositions, const vector<PathfindingMap>& costMaps, const vector<PathfindingMap>& targetMaps, const vector<const TimeMap*>& timeMaps, const vector<vector<pii>>& targetTiles, int numCandidates) {
+    const double INF = 1000000;
+    int numWorkers = workerPositions.size();
+    int numTargets = targetTiles.size();
+    vector<vector<double>> bounds(numWorkers, vector<double>(numTargets, -1));
+    threadPool.parallelFor(numWorkers, [&](int wi) {
+        double minStepCost = INF;
+        for (auto& column : costMaps[wi].weights) {
+            for (double c : column) minStepCost = min(minStepCost, c);
+        }
+        minStepCost = max(0.0, minStepCost);
+
+        auto& timeMap = *timeMaps[wi];
+        for (int t = 0; t < numTargets; t++) {
+            double value = 0;
+            int steps = MAX_MAP_SIZE;
+            bool reachable = false;
+            for (auto p : targetTiles[t]) {
+                value = max(value, targetMaps[wi].weights[p.first][p.second]);
+                steps = min(steps, max(abs(p.first - workerPositions[wi].first), abs(p.second - workerPositions[wi].second)));
+                reachable |= timeMap.at(p.first, p.second) < INF;
+            }
+            if (reachable) bounds[wi][t] = value / (1 + minStepCost * steps);
+        }
+    });
+
+    return selectCandidates(bounds, numCandidates);
+}
 
 void matchWorkers() {
     if (planet != Earth) return;
 
     auto matchWorkersStart = millis();
+    matchingAugmentations = 0;
 
     // Cluster karbonite
-    auto groups = groupKarbonite();
+    karboniteClusters.update(miningSpeed);
+    auto& groups = karboniteClusters.groups();
+    if ((int)gc.get_round() == debugRound) {
+        printKarboniteGroups();
+    }
     
     // Find all our workers and structures which can be built or repaired
     vector<BotWorker*> workers;
@@ -141,72 +221,190 @@ void matchWorkers() {
         }
     }
 
-    // Note: Hungarian algorithm code will otherwise try to read out of bounds
+    // Note: the matching code will otherwise try to read out of bounds
     if (workers.size() == 0) return;
 
-    HungarianAlgorithm matcher;
-    Pathfinder pathfinder;
-    int numTargets = groups.size()*3 + unitTargets.size()*5;
+    // Targets are the karbonite groups followed by the structures
+    int numTargets = groups.size() + unitTargets.size();
 
-    // If there are no targets or if we have very little time
-    // then fall back to the previous algorithm
-    if (numTargets == 0 || lowTimeRemaining) {
+    // If there are no targets then fall back to the previous algorithm
+    if (numTargets == 0) {
         for (auto* worker : workers) {
             worker->calculatedTargetMap = PathfindingMap();
         }
         return;
     }
 
+    // With very little time we keep following the matching from an earlier turn
+    if (timeBudget.quality(TimePhase::Matching) < 0.25) {
+        reusePreviousWorkerTargets(workers, groups, unitTargets);
+        matchWorkersTime += millis() - matchWorkersStart;
+        return;
+    }
+
     const double INF = 1000000;
-    vector<int> timeToReachTarget(numTargets, (int)INF);
+    // Times when the workers matched to each target in the previous iteration get there, in increasing order
+    vector<vector<int>> arrivalTimes(numTargets);
 
-    int numIterations = 2;
+    // The matching is anytime: every iteration starts from a greedy matching and improves it while there is time left.
+    // The second iteration refines the estimates of when other workers reach each target, it is skipped if the first one used up the budget.
+    const int maxIterations = 2;
+
+    // Everything the parallel jobs need from the game controller is read here, the jobs must not call into it
+    bool debug = (int)gc.get_round() == debugRound;
+    vector<pii> workerPositions(workers.size());
+    vector<PathfindingMap> costMaps(workers.size());
+    for (int wi = 0; wi < (int)workers.size(); wi++) {
+        auto pos = workers[wi]->unit.get_map_location();
+        workerPositions[wi] = pii(pos.get_x(), pos.get_y());
+        costMaps[wi] = workers[wi]->getCostMap();
+    }
+    vector<pii> targetPositions(unitTargets.size());
+    vector<int> targetHealthToRepair(unitTargets.size());
+    for (int i = 0; i < (int)unitTargets.size(); i++) {
+        auto pos = unitTargets[i]->get_map_location();
+        targetPositions[i] = pii(pos.get_x(), pos.get_y());
+        targetHealthToRepair[i] = unitTargets[i]->get_max_health() - unitTargets[i]->get_health();
+    }
+    // Tiles from which a worker can work on each target
+    vector<vector<pii>> targetTiles(numTargets);
+    for (int i = 0; i < (int)groups.size(); i++) {
+        targetTiles[i] = groups[i].tiles;
+    }
+    for (int i = 0; i < (int)unitTargets.size(); i++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                int nx = targetPositions[i].first + dx;
+                int ny = targetPositions[i].second + dy;
+                if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                targetTiles[groups.size() + i].push_back(pii(nx, ny));
+            }
+        }
+    }
 
     auto t0 = millis();
-    vector<vector<vector<double>>> distanceMaps(workers.size());
+    // Time maps that are neither cached nor speculated are computed in parallel and then added to the cache.
+    // Cached maps computed from another time cost map are stale and are computed again.
+    auto timeCost = workerTimeCostMap();
+    uint64_t timeCostVersion = checksumTimeCost(timeCost);
+    bool speculatedTimeMapsValid = timeCostVersion == speculativeTimeMapsKey;
+    timeMapCache.newGeneration();
+    vector<const TimeMap*> timeMaps(workers.size());
+    vector<int> missingTimeMaps;
     for (int wi = 0; wi < (int)workers.size(); wi++) {
-        auto* worker = workers[wi];
-        auto pos = worker->unit.get_map_location();
-        auto costMap = worker->getCostMap();
-        distanceMaps[wi] = pathfinder.getDistanceToAllTiles(pos.get_x(), pos.get_y(), costMap);
+        auto positionKey = workerPositions[wi];
+        timeMaps[wi] = timeMapCache.find(positionKey, timeCostVersion);
+        if (timeMaps[wi] != nullptr) continue;
+
+        auto speculated = speculativeTimeMaps.find(positionKey);
+        if (speculated != speculativeTimeMaps.end() && speculatedTimeMapsValid) {
+            speculativeTimeMapHits++;
+            timeMaps[wi] = timeMapCache.insert(positionKey, timeCostVersion, move(speculated->second));
+            speculativeTimeMaps.erase(speculated);
+        }
+        else {
+            missingTimeMaps.push_back(wi);
+        }
     }
+    if (!missingTimeMaps.empty()) {
+        vector<TimeMap> computedTimeMaps(missingTimeMaps.size());
+        threadPool.parallelFor(missingTimeMaps.size(), [&](int i) {
+            Pathfinder pathfinder;
+            auto pos = workerPositions[missingTimeMaps[i]];
+            computedTimeMaps[i] = TimeMap(pathfinder.getDistanceToAllTiles(pos.first, pos.second, timeCost));
+        });
+        // Maps used in this generation are not evicted, so the earlier pointers stay valid
+        for (int i = 0; i < (int)missingTimeMaps.size(); i++) {
+            int wi = missingTimeMaps[i];
+            timeMaps[wi] = timeMapCache.insert(workerPositions[wi], timeCostVersion, move(computedTimeMaps[i]));
+        }
+    }
+    matchWorkersDijkstraTime += millis() - t0;
+
+    // getOriginalTargetMap updates the worker, so it is called here and not in the parallel jobs.
+    // These are the target maps of the first iteration, they are updated at the start of every later one.
+    vector<PathfindingMap> targetMaps(workers.size());
+    for (int wi = 0; wi < (int)workers.size(); wi++) {
+        targetMaps[wi] = workers[wi]->getOriginalTargetMap();
+    }
+
+    // Fewer candidates when there is less time, workerMatchingCandidates <= 0 considers every pair
+    int numCandidates = numTargets;
+    if (workerMatchingCandidates > 0) {
+        numCandidates = max(MIN_WORKER_MATCHING_CANDIDATES, (int)ceil(workerMatchingCandidates * timeBudget.quality(TimePhase::Matching)));
+    }
+    auto candidates = selectMatchingCandidates(workerPositions, costMaps, targetMaps, timeMaps, targetTiles, numCandidates);
+    // When recording for lapbench every pair is scored and matched, so that the recording has the full problem
+    // that the pruned one can be compared with. The candidates that would have been used are recorded with it.
+    bool recordMatching = false;
+    vector<vector<int>> selectedCandidates;
+#ifndef NDEBUG
+    recordMatching = getenv("LAP_RECORD_DIR") != nullptr;
+#endif
+    if (recordMatching) {
+        selectedCandidates = candidates;
+        candidates = selectMatchingCandidates(workerPositions, costMaps, targetMaps, timeMaps, targetTiles, numTargets);
+    }
+
+    t0 = millis();
+    vector<vector<vector<double>>> distanceMaps(workers.size());
+    threadPool.parallelFor(workers.size(), [&](int wi) {
+        // Skip the rest if we run out of time, nothing has been matched yet so the result would not be used
+        if (turnDeadlinePassed.load(memory_order_relaxed)) return;
+        // Only the distances to the candidate targets are needed
+        Bitboard candidateTiles;
+        for (int t : candidates[wi]) {
+            for (auto p : targetTiles[t]) candidateTiles.set(p.first, p.second);
+        }
+        Pathfinder pathfinder;
+        distanceMaps[wi] = pathfinder.getDistanceToTiles(workerPositions[wi].first, workerPositions[wi].second, costMaps[wi], candidateTiles);
+    });
     matchWorkersDijkstraTime2 += millis() - t0;
 
-    for (int it=0; it < numIterations; it++) {
-        bool finalIteration = it == numIterations - 1;
+    if (turnPreempted("worker matching")) {
+        reusePreviousWorkerTargets(workers, groups, unitTargets);
+        matchWorkersTime += millis() - matchWorkersStart;
+        return;
+    }
+
+    // Rows and columns are identified across turns so that the matching can be warm started.
+    // Groups are identified by their first tile, which stays the same until it is mined out.
+    vector<int64_t> workerKeys(workers.size());
+    for (int wi = 0; wi < (int)workers.size(); wi++) {
+        workerKeys[wi] = workers[wi]->id;
+    }
+    vector<int64_t> targetKeys(numTargets);
+    for (int i = 0; i < (int)groups.size(); i++) {
+        auto tile = groups[i].tiles[0];
+        targetKeys[i] = (int64_t)(tile.first * MAX_MAP_SIZE + tile.second) * 2 + 0;
+    }
+    for (int i = 0; i < (int)unitTargets.size(); i++) {
+        auto pos = targetPositions[i];
+        targetKeys[groups.size() + i] = (int64_t)(pos.first * MAX_MAP_SIZE + pos.second) * 2 + 1;
+    }
+
+    workerMatcher.cancelFlag = &turnDeadlinePassed;
+    for (int it=0; it < maxIterations; it++) {
         // costMatrix[i][j] = cost for worker i to be assigned target j
-        // Note that scores will first be stored here and then the matrix values will be negated to convert them to costs
-        vector<vector<double>> costMatrix (workers.size(), vector<double>(numTargets));
+        // Note that scores will first be stored here and then the matrix values will be negated to convert them to costs.
+        // Pairs that are not candidates are treated like unreachable targets.
+        vector<vector<double>> costMatrix (workers.size(), vector<double>(numTargets, -INF));
         // timeMatrix[i][j] = turns for worker i to reach target j
         vector<vector<int>> timeMatrix (workers.size(), vector<int>(numTargets));
 
-        for (int wi = 0; wi < (int)workers.size(); wi++) {
-            auto* worker = workers[wi];
-            auto targetMap = worker->getOriginalTargetMap();
-            auto pos = worker->unit.get_map_location();
-            auto distanceStart = millis();
-            auto& distanceMap = distanceMaps[wi];
-
-            auto positionKey = make_pair(pos.get_x(), pos.get_y());
-            vector<vector<double> >  timeMap;
-            if (cachedTimeMaps.count(positionKey))
-                timeMap = cachedTimeMaps[positionKey];
-            else {
-                // Workers take approximately 2 ticks to move one tile
-                // TODO: Can optimize to simply 2 times BFS-distance
-                PathfindingMap timeCost(w, h);
-                timeCost += 2;
-                for (int x = 0; x < w; x++) {
-                    for (int y = 0; y < h; y++) {
-                        if (isinf(passableMap.weights[x][y])) timeCost.weights[x][y] = passableMap.weights[x][y];
-                    }
-                }
-
-                timeMap = pathfinder.getDistanceToAllTiles(pos.get_x(), pos.get_y(), timeCost);
-                cachedTimeMaps[positionKey] = timeMap;
+        if (it > 0) {
+            for (int wi = 0; wi < (int)workers.size(); wi++) {
+                targetMaps[wi] = workers[wi]->getOriginalTargetMap();
             }
-            matchWorkersDijkstraTime += millis() - distanceStart;
-            if ((int)gc.get_round() == debugRound && wi == 0) {
+        }
+
+        // Every row only depends on data that is not modified while the rows are computed,
+        // so the result is the same as when computing them one after another
+        auto computeRow = [&](int wi) {
+            auto& targetMap = targetMaps[wi];
+            auto& distanceMap = distanceMaps[wi];
+            auto& timeMap = *timeMaps[wi];
+            if (debug && wi == 0) {
                 
                 // print({ 0, 0, w - 1, h - 1 }, 0, 60, [&](int x, int y) { return distanceToInitialLocation[0].weights[x][y]; });
                 // print({ 0, 0, w - 1, h - 1 }, 0, 60, [&](int x, int y) { return distanceToInitialLocation[1].weights[x][y]; });
@@ -216,113 +414,78 @@ void matchWorkers() {
                 
 
                 // print({ 0, 0, w - 1, h - 1 }, 0, 150, [&](int x, int y) { return targetMap.weights[x][y]; });
-                // print({ 0, 0, w - 1, h - 1 }, 0, 80, [&](int x, int y) { return timeMap[x][y]; });
+                // print({ 0, 0, w - 1, h - 1 }, 0, 80, [&](int x, int y) { return timeMap.at(x, y); });
                 // print({ 0, 0, w - 1, h - 1 }, 0, 150, [&](int x, int y) { return distanceMap[x][y]; });
                 // if (ourTeam == 1) exit(0);
             }
 
-            for (int i = 0; i < (int)groups.size(); i++) {
+            for (int i : candidates[wi]) {
                 double score = 0;
-                double totalKarbonite = 0;
                 double minTime = INF;
-                for (auto p : groups[i].tiles) {
-                    minTime = min(minTime, timeMap[p.first][p.second]);
-                    totalKarbonite += karboniteMap.weights[p.first][p.second];
-                }
-                if (minTime >= INF) {
-                    costMatrix[wi][i*3 + 0] = -INF;
-                    costMatrix[wi][i*3 + 1] = -INF;
-                    costMatrix[wi][i*3 + 2] = -INF;
-                    continue;
-                }
-
-                assert(totalKarbonite > 0);
-
-                // How many ticks the best worker will have already mined at this spot before we get there
-                double previousWork1 = max(0.0, minTime - timeToReachTarget[i*3 + 0]);
-                // How many ticks the best and 2nd best worker will have spent here before the 3rd worker (us) gets there
-                double previousWork2 = previousWork1 + max(0.0, minTime - timeToReachTarget[i*3 + 1]);
-
-                for (auto p : groups[i].tiles) {
+                for (auto p : targetTiles[i]) {
                     score = max(score, targetMap.weights[p.first][p.second] / (1 + distanceMap[p.first][p.second]));
-                    minTime = min(minTime, timeMap[p.first][p.second]);
+                    minTime = min(minTime, timeMap.at(p.first, p.second));
                 }
+                if (minTime >= INF) continue;
 
+                costMatrix[wi][i] = score;
+                timeMatrix[wi][i] = minTime;
 
-                // TODO: Use for loop instead
-                double score0 = score;
-                double score1 = score * (totalKarbonite - miningSpeed*previousWork1)/totalKarbonite;
-                double score2 = score * (totalKarbonite - miningSpeed*previousWork2)/totalKarbonite;
-
-                score0 = max(score0, 0.0);
-                score1 = max(score1, 0.0);
-                score2 = max(score2, 0.0);
+                if (debug) {
+                    cout << "Worker " << wi << " score for target " << i << ": " << score << endl;
+                }
+            }
+        };
+        if (debug) {
+            // Keep the debug output in order
+            for (int wi = 0; wi < (int)workers.size(); wi++) computeRow(wi);
+        } else {
+            threadPool.parallelFor(workers.size(), computeRow);
+        }
 
-                costMatrix[wi][i*3 + 0] = score0;
-                costMatrix[wi][i*3 + 1] = score1 / 2;
-                costMatrix[wi][i*3 + 2] = score2 / 3;
-                timeMatrix[wi][i*3 + 0] = minTime;
-                timeMatrix[wi][i*3 + 1] = minTime;
-                timeMatrix[wi][i*3 + 2] = minTime;
 
-                if ((int)gc.get_round() == debugRound) {
-                    cout << "Worker " << wi << " score for group " << i << ": " << score0 << " " << score1 << " " << score2 << endl;
-                }
+        // Diminishing returns when several workers go to the same target.
+        // The k-th worker at a target gets a fraction factors[k] of the score it would get alone, the number of factors
+        // is the capacity of the target. The marginal costs are the score lost by the best worker for the target.
+        vector<vector<double>> marginalCosts(numTargets);
+        for (int i = 0; i < numTargets; i++) {
+            double bestScore = 0;
+            for (int wi = 0; wi < (int)workers.size(); wi++) {
+                bestScore = max(bestScore, costMatrix[wi][i]);
             }
-            int offset = groups.size()*3;
 
-            for (int i = 0; i < (int)unitTargets.size(); i++) {
-                auto pos2 = unitTargets[i]->get_map_location();
-                double score = 0;
-                double minTime = INF;
-                for (int dx = -1; dx <= 1; dx++) {
-                    for (int dy = -1; dy <= 1; dy++) {
-                        int nx = pos2.get_x() + dx;
-                        int ny = pos2.get_y() + dy;
-                        if (nx < 0 || nx < 0 || nx >= w || ny >= h) continue;
-                        score = max(score, targetMap.weights[nx][ny] / (1 + distanceMap[nx][ny]));
-                        minTime = min(minTime, timeMap[nx][ny]);
+            vector<double> factors;
+            if (i < (int)groups.size()) {
+                double totalKarbonite = groups[i].totalKarbonite;
+                assert(totalKarbonite > 0);
+
+                auto& arrivals = arrivalTimes[i];
+                factors.push_back(1);
+                for (int k = 1; k < 3; k++) {
+                    // When the k-th worker gets here, taken from the previous iteration if it had that many workers here
+                    int arrival = arrivals.empty() ? 0 : arrivals[min(k, (int)arrivals.size() - 1)];
+                    // How many ticks the workers before us will have already mined at this spot before we get there
+                    double previousWork = 0;
+                    for (int j = 0; j < k && j < (int)arrivals.size(); j++) {
+                        previousWork += max(0, arrival - arrivals[j]);
                     }
+                    factors.push_back(max(0.0, (totalKarbonite - miningSpeed*previousWork)/totalKarbonite) / (k + 1));
                 }
-
-                if (minTime >= INF) {
-                    costMatrix[wi][offset + i*5 + 0] = -INF;
-                    costMatrix[wi][offset + i*5 + 1] = -INF;
-                    costMatrix[wi][offset + i*5 + 2] = -INF;
-                    costMatrix[wi][offset + i*5 + 3] = -INF;
-                    costMatrix[wi][offset + i*5 + 4] = -INF;
-                    continue;
+            } else {
+                // Enough workers to finish the structure in about 10 turns
+                // TODO: Slightly incorrect if repairing instead of building, should use repairSpeed
+                int capacity = (targetHealthToRepair[i - groups.size()] + buildSpeed*10 - 1) / (buildSpeed*10);
+                capacity = max(1, min(capacity, MAX_WORKERS_PER_STRUCTURE));
+                for (int k = 0; k < capacity; k++) {
+                    factors.push_back(1 - k / (double)capacity);
                 }
+            }
 
-                auto totalHealthToRepair = unitTargets[i]->get_max_health() - unitTargets[i]->get_health();
-                // How many ticks the best worker will have already built at this spot before we get there
-                double previousWork1 = max(0.0, minTime - timeToReachTarget[offset + i*3 + 0]);
-                // How many ticks the best and 2nd best worker will have spent here before the 3rd worker (us) gets there
-                double previousWork2 = previousWork1 + max(0.0, minTime - timeToReachTarget[offset + i*3 + 1]);
-
-                // TODO: Slightly incorrect if repairing instead of building, should use repairSpeed
-                double score0 = score;
-                double score1 = score * (totalHealthToRepair - buildSpeed*previousWork1)/totalHealthToRepair;
-                double score2 = score * (totalHealthToRepair - buildSpeed*previousWork2)/totalHealthToRepair;
-
-                score0 = max(score0, 0.0);
-                score1 = max(score1, 0.0);
-                score2 = max(score2, 0.0);
-
-                costMatrix[wi][offset + i*5 + 0] = score;
-                costMatrix[wi][offset + i*5 + 1] = score * 0.8;
-                costMatrix[wi][offset + i*5 + 2] = score * 0.6;
-                costMatrix[wi][offset + i*5 + 3] = score * 0.4;
-                costMatrix[wi][offset + i*5 + 4] = score * 0.2;
-                timeMatrix[wi][offset + i*5 + 0] = minTime;
-                timeMatrix[wi][offset + i*5 + 1] = minTime;
-                timeMatrix[wi][offset + i*5 + 2] = minTime;
-                timeMatrix[wi][offset + i*5 + 3] = minTime;
-                timeMatrix[wi][offset + i*5 + 4] = minTime;
+            for (double factor : factors) {
+                marginalCosts[i].push_back(bestScore * (1 - factor));
             }
         }
 
-
         // Invert cost matrix
         double mx = 0;
         for (int i = 0; i < (int)costMatrix.size(); i++) {
@@ -333,19 +496,61 @@ void matchWorkers() {
             for (auto& v : costMatrix[i]) v = mx - v;
         }
 
-        auto hungarianStart = millis();
+        // More than any candidate costs including the marginal cost, so that as many workers as possible get a target
+        double unassignedCost = INF + 2 * mx;
+
+        // Record the problems so that the solvers can be benchmarked on them, see lapbench.cpp
+        if (recordMatching) {
+            MatchingProblem problem;
+            problem.costs = costMatrix;
+            problem.marginalCosts = marginalCosts;
+            problem.unassignedCost = unassignedCost;
+            problem.impossibleCost = INF;
+            problem.candidates.resize(workers.size());
+            for (int wi = 0; wi < (int)workers.size(); wi++) {
+                for (int i : selectedCandidates[wi]) {
+                    if (costMatrix[wi][i] < INF) problem.candidates[wi].push_back(i);
+                }
+            }
+            stringstream path;
+            path << getenv("LAP_RECORD_DIR") << "/matching_" << ourTeam << "_" << gc.get_round() << "_" << it << ".txt";
+            writeMatchingProblem(path.str(), problem);
+        }
+
+        auto assignmentStart = millis();
+        // A valid matching right away, then improve it while there is time
         vector<int> assignment;
-        if (workers.size() < 30) {
-            matcher.Solve(costMatrix, assignment);
-        } else {
-            greedyWeightedMatching(costMatrix, assignment);
+        greedyCapacitatedMatching(costMatrix, marginalCosts, assignment);
+        if (!timeBudget.overBudget(TimePhase::Matching)) {
+            vector<vector<pair<int, double>>> candidateCosts(workers.size());
+            for (int wi = 0; wi < (int)workers.size(); wi++) {
+                for (int i : candidates[wi]) {
+                    if (costMatrix[wi][i] < INF) candidateCosts[wi].push_back(make_pair(i, costMatrix[wi][i]));
+                }
+            }
+            vector<int> optimalAssignment;
+            workerMatcher.solveSparse(candidateCosts, marginalCosts, workerKeys, targetKeys, unassignedCost, optimalAssignment);
+            matchingAugmentations += workerMatcher.augmentations;
+            if (workerMatcher.cancelled) {
+                // The partial assignment leaves many workers without a target, keep the greedy one
+                turnPreempted("worker matching");
+            } else {
+                assignment = optimalAssignment;
+            }
         }
-        hungarianTime += millis() - hungarianStart;
+        assignmentTime += millis() - assignmentStart;
         assert(assignment.size() == workers.size());
+
+        // The last iteration sets the target maps
+        bool finalIteration = it == maxIterations - 1 || timeBudget.overBudget(TimePhase::Matching) || turnPreempted("worker matching");
+        if (finalIteration) {
+            previousWorkerTargets.clear();
+            previousWorkerTargetsRound = gc.get_round();
+        }
         
 
         // Reset
-        for (int i = 0; i < (int)timeToReachTarget.size(); i++) timeToReachTarget[i] = (int)INF;
+        for (auto& arrivals : arrivalTimes) arrivals.clear();
 
         for (int wi = 0; wi < (int)assignment.size(); wi++) {
             // cout << "Worker " << wi << " goes to " << assignment[wi] << endl;
@@ -358,19 +563,18 @@ void matchWorkers() {
                 continue;
             }
 
-            timeToReachTarget[assignment[wi]] = timeMatrix[wi][assignment[wi]];
-            // cout << "Time to reach group " << (assignment[wi]/3) << " + " << (assignment[wi] % 3) << " = " << timeToReachTarget[assignment[wi]] << endl;
+            arrivalTimes[target].push_back(timeMatrix[wi][target]);
 
             // Performance
             if (!finalIteration) continue;
 
             assert(target >= 0);
-            PathfindingMap mask(w, h);
-            int offset = groups.size()*3;
+            int offset = groups.size();
+            WorkerTarget workerTarget;
 
             if (target >= offset) {
                 // Move towards a building
-                target = (target - offset)/5;
+                target -= offset;
                 assert(target < (int)unitTargets.size());
                 auto pos2 = unitTargets[target]->get_map_location();
 
@@ -378,30 +582,26 @@ void matchWorkers() {
                     cout << "Worker " << wi << " goes to a building at " << pos2.get_x() << " " << pos2.get_y() << endl;
                 }
 
-                for (int dx = -1; dx <= 1; dx++) {
-                    for (int dy = -1; dy <= 1; dy++) {
-                        int nx = pos2.get_x() + dx;
-                        int ny = pos2.get_y() + dy;
-                        if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
-                        mask.weights[nx][ny] = 1;
-                    }
-                }
+                workerTarget = { pos2.get_x(), pos2.get_y(), true };
             } else {
                 // Move towards a group
-                target /= 3;
                 assert(target < (int)groups.size());
 
                 if ((int)gc.get_round() == debugRound) {
                     cout << "Worker " << wi << " goes to group " << target << " with cost " << costMatrix[wi][target] << endl;
                 }
 
-                for (auto p : groups[target].tiles) {
-                    mask.weights[p.first][p.second] = 1;
-                }
+                auto tile = groups[target].tiles[0];
+                workerTarget = { tile.first, tile.second, false };
             }
 
-            worker->calculatedTargetMap = mask * worker->getOriginalTargetMap();
+            previousWorkerTargets[worker->id] = workerTarget;
+            worker->calculatedTargetMap = workerTargetMask(workerTarget, groups) * worker->getOriginalTargetMap();
         }
+
+        if (finalIteration) break;
+
+        for (auto& arrivals : arrivalTimes) sort(arrivals.begin(), arrivals.end());
     }
 
     matchWorkersTime += millis() - matchWorkersStart;
@@ -410,57 +610,109 @@ void matchWorkers() {
     // exit(0);
 }
 
-// Returns score for factory placement
-// Will be on the order of magnitude of 1 for a well placed factory
-// May be negative, but mostly in the [0,1] range
-double structurePlacementScore(int x, int y, UnitType unitType) {
-    double nearbyTileScore = 1;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dx == 0 && dy == 0) continue;
-            if (x + dx < 0 || x + dx >= w || y + dy <= 0 || y + dy >= h) continue;
+// Everything structurePlacementScore needs, for every tile of the map.
+// Computed from the maps once per turn without calling into the engine, and updated locally when we place a blueprint.
+struct StructurePlacementLayer {
+    // Recomputes the layer if it is from an earlier turn
+    void update();
+    // Call when a blueprint has been placed on the tile
+    void onStructurePlaced(int x, int y);
+
+    // True if a structure could be placed on the tile as far as we know
+    bool occupiable(int x, int y) const {
+        return passableTerrain.test(x, y) && !unitOccupancy.test(x, y) && !enemyExactPositions.test(x, y) && !placed.test(x, y);
+    }
+
+    // The score without the penalty for nearby structures, which is the only part that depends on the structure type
+    PathfindingMap baseScore;
+    // Our factories and rockets within a squared distance of 2, including the tile itself
+    int nearbyStructures[MAX_MAP_SIZE][MAX_MAP_SIZE];
+
+private:
+    int round = -1;
+    // Blueprints placed this turn, they are not in the unit snapshots yet
+    Bitboard placed;
+};
+
+StructurePlacementLayer structurePlacementLayer;
 
-            if (!isinf(passableMap.weights[x+dx][y+dy])) {
-                // Traversable
-                // structureProximityMap is typically 0.4 on the 8 tiles around a factory
-                nearbyTileScore += 0.4 / (0.4 + structureProximityMap.weights[x+dx][y+dy]);
+void StructurePlacementLayer::update() {
+    if (round == (int)gc.get_round()) return;
+    round = gc.get_round();
+    placed.clear();
+
+    baseScore = PathfindingMap(w, h);
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) {
+            nearbyStructures[x][y] = 0;
+
+            double nearbyTileScore = 1;
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    if (dx == 0 && dy == 0) continue;
+                    if (x + dx < 0 || x + dx >= w || y + dy < 0 || y + dy >= h) continue;
+
+                    if (!isinf(passableMap.weights[x+dx][y+dy])) {
+                        // Traversable
+                        // structureProximityMap is typically 0.4 on the 8 tiles around a factory
+                        nearbyTileScore += 0.4 / (0.4 + structureProximityMap.weights[x+dx][y+dy]);
+                    }
+                }
             }
-        }
-    }
-    nearbyTileScore /= 16.0f;
-    assert(nearbyTileScore <= 1.01f);
-    assert(nearbyTileScore >= 0);
+            nearbyTileScore /= 16.0f;
+            assert(nearbyTileScore <= 1.01f);
+            assert(nearbyTileScore >= 0);
 
-    auto pos = MapLocation(Earth, x, y);
+            // nearbyTileScore will be approximately 1 if there are 8 free tiles around the factory.
 
-    // nearbyTileScore will be approximately 1 if there are 8 free tiles around the factory.
+            double score = nearbyTileScore;
+            // Score will go to zero when there is more than 50 karbonite on the tile
+            score -= karboniteMap.weights[x][y] / 50.0;
 
-    double score = nearbyTileScore;
-    // Score will go to zero when there is more than 50 karbonite on the tile
-    score -= karboniteMap.weights[x][y] / 50.0;
-    
-    score += sqrt(workerAdditiveMap.weights[x][y]) * 0.4;
+            score += sqrt(workerAdditiveMap.weights[x][y]) * 0.4;
+
+            // We like building factories in clusters (with some spacing)
+            //if (nearbyFactories > 1) score *= 1.2f;
+            //else if (nearbyFactories > 0) score *= 1.1f;
+
+            // enemyNearbyMap is 1 at enemies and falls off slowly
+            score /= enemyNearbyMap.weights[x][y] + 1.0;
+            baseScore.weights[x][y] = score;
+        }
+    }
 
-    auto nearbyUnits = gc.sense_nearby_units(pos, 2);
-    double nearbyStructures = 0;
-    for (auto& f : nearbyUnits) {
-        if (f.get_team() == ourTeam && (f.get_unit_type() == Rocket || f.get_unit_type() == Factory)) 
-            nearbyStructures++;
+    for (auto& u : ourUnitInfos) {
+        if (u.get_unit_type() == Rocket || u.get_unit_type() == Factory) {
+            onStructurePlaced(u.get_x(), u.get_y());
+        }
     }
+    placed.clear();
+}
 
+void StructurePlacementLayer::onStructurePlaced(int x, int y) {
+    placed.set(x, y);
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            int nx = x + dx;
+            int ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+            nearbyStructures[nx][ny]++;
+        }
+    }
+}
+
+// Returns score for factory placement
+// Will be on the order of magnitude of 1 for a well placed factory
+// May be negative, but mostly in the [0,1] range
+double structurePlacementScore(int x, int y, UnitType unitType) {
+    double score = structurePlacementLayer.baseScore.weights[x][y];
+    double nearbyStructures = structurePlacementLayer.nearbyStructures[x][y];
     if (unitType == Rocket) {
         score /= nearbyStructures + 1.0;
     }
     else {
         score /= nearbyStructures * 0.3 + 1.0;
     }
-
-    // We like building factories in clusters (with some spacing)
-    //if (nearbyFactories > 1) score *= 1.2f;
-    //else if (nearbyFactories > 0) score *= 1.1f;
-
-    // enemyNearbyMap is 1 at enemies and falls off slowly
-    score /= enemyNearbyMap.weights[x][y] + 1.0;
     return score;
 }
 
@@ -530,7 +782,7 @@ void BotWorker::tick() {
 
     auto unitMapLocation = unit.get_location().get_map_location();
 
-    if (workersMove && gc.is_move_ready(unit.get_id())) {
+    if (workersMove && gc.is_move_ready(unit.get_id()) && !turnPreempted("movement")) {
         unitMapLocation = getNextLocation();
         moveToLocation(unitMapLocation);
     }
@@ -555,6 +807,7 @@ void BotWorker::tick() {
                     //assert(!hasHarvested);
                     didBuild = true;
                     gc.build(id, placeId);
+                    onBuild(id, placeId);
                 }
             });
         }
@@ -590,17 +843,18 @@ void BotWorker::tick() {
                 hasHarvested = true;
                 gc.harvest(id, dir);
                 auto pos = unitMapLocation.add(dir);
-                karboniteMap.weights[pos.get_x()][pos.get_y()] = gc.get_karbonite_at(pos);
+                karboniteIndex.set(pos.get_x(), pos.get_y(), gc.get_karbonite_at(pos));
             }
         });
     }
 
     if (planet == Earth) {
+        structurePlacementLayer.update();
         for (int i = 0; i < 8; i++) {
             Direction d = (Direction) i;
             // Placing 'em blueprints
             auto newLocation = unitMapLocation.add(d);
-            if(isOnMap(newLocation) && gc.can_sense_location(newLocation) && gc.is_occupiable(newLocation)) {
+            if(isOnMap(newLocation) && canSenseLocation.test(newLocation.get_x(), newLocation.get_y()) && structurePlacementLayer.occupiable(newLocation.get_x(), newLocation.get_y())) {
                 int x = newLocation.get_x();
                 int y = newLocation.get_y();
                 double score = state.typeCount[Factory] < 4 ? (1.5 - 0.1 * state.typeCount[Factory]) : 5.0 / (5.0 + state.typeCount[Factory]);
@@ -614,10 +868,12 @@ void BotWorker::tick() {
                 macroObjects.emplace_back(score, unit_type_get_blueprint_cost(Factory), 2, [=]{
                     if (lastFactoryBlueprintTurn != (int)gc.get_round() && gc.can_blueprint(id, Factory, d)) {
                         gc.blueprint(id, Factory, d);
+                        onBlueprint(id);
+                        structurePlacementLayer.onStructurePlaced(x, y);
                         lastFactoryBlueprintTurn = gc.get_round();
                     }
                 });
-                auto researchInfo = gc.get_research_info();
+                const auto& researchInfo = gameCache.researchInfo();
                 if (researchInfo.get_level(Rocket) >= 1) {
                     double factor = 0.01;
                     if (gc.get_round() > 600) {
@@ -651,6 +907,8 @@ void BotWorker::tick() {
                     macroObjects.emplace_back(score, unit_type_get_blueprint_cost(Rocket), 2, [=]{
                         if(lastRocketBlueprintTurn != (int)gc.get_round() && gc.can_blueprint(id, Rocket, d)){
                             gc.blueprint(id, Rocket, d);
+                            onBlueprint(id);
+                            structurePlacementLayer.onStructurePlaced(x, y);
                             lastRocketBlueprintTurn = gc.get_round();
                             timesStuck = 0;
                         }
@@ -661,6 +919,132 @@ void BotWorker::tick() {
     }
 }
 
+// Picks which worker replicates in which direction.
+// Workers prefer to replicate towards where they are going, so every worker needs a pathfinding search.
+// The searches are done once per turn for all workers (in parallel) the first time a replicate action runs,
+// and the following replicate actions that turn take the best worker that can still replicate.
+struct ReplicationPlanner {
+    // Returns true if a worker replicated
+    bool replicateBest();
+
+private:
+    struct Candidate {
+        unsigned id;
+        Position from;
+        Position next;
+        double score;
+    };
+    int round = -1;
+    // Best first
+    vector<Candidate> candidates;
+
+    void plan();
+};
+
+ReplicationPlanner replicationPlanner;
+
+void ReplicationPlanner::plan() {
+    round = gc.get_round();
+    candidates.clear();
+
+    vector<BotWorker*> workers;
+    for (auto& u : ourUnits) {
+        if (u.get_unit_type() == Worker && u.get_location().is_on_map() && u.get_ability_heat() < 10) {
+            BotWorker* botunit = (BotWorker*)unitMap[u.get_id()];
+            if (botunit != nullptr) workers.push_back(botunit);
+        }
+    }
+
+    // Same as getNextLocation(from, false), but with the searches in parallel
+    vector<PathfindingMap> targetMaps(workers.size());
+    vector<PathfindingMap> costMaps(workers.size());
+    vector<char> needsPathfinding(workers.size());
+    candidates.resize(workers.size());
+    for (size_t i = 0; i < workers.size(); i++) {
+        auto from = workers[i]->unit.get_map_location();
+        MapLocation next;
+        needsPathfinding[i] = workers[i]->preparePathfinding(from, false, targetMaps[i], costMaps[i], next);
+        candidates[i] = { workers[i]->id, Position(from.get_x(), from.get_y()), Position(next.get_x(), next.get_y()), workers[i]->pathfindingScore };
+    }
+
+    double start = millis();
+    vector<char> planned(workers.size(), 1);
+    threadPool.parallelFor(workers.size(), [&](int i) {
+        if (!needsPathfinding[i]) return;
+        if (turnDeadlinePassed.load(memory_order_relaxed)) {
+            planned[i] = false;
+            return;
+        }
+        Pathfinder pathfinder;
+        auto path = pathfinder.getPath(candidates[i].from, targetMaps[i], costMaps[i]);
+        candidates[i].next = path[path.size() > 1 ? 1 : 0];
+        candidates[i].score = pathfinder.bestScore;
+    });
+    pathfindingTime += millis() - start;
+
+    // Workers that were not planned before the deadline do not replicate this turn
+    int count = 0;
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (planned[i]) candidates[count++] = candidates[i];
+    }
+    candidates.resize(count);
+    stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+}
+
+bool ReplicationPlanner::replicateBest() {
+    if (round != (int)gc.get_round()) {
+        plan();
+    }
+
+    for (auto& candidate : candidates) {
+        auto* botunit = (BotWorker*)unitMap[candidate.id];
+        if (botunit == nullptr || !botunit->unit.get_location().is_on_map() || botunit->unit.get_ability_heat() >= 10) continue;
+
+        auto unitID = candidate.id;
+        auto unitMapLocation = botunit->unit.get_map_location();
+        if (unitMapLocation.get_x() != candidate.from.x || unitMapLocation.get_y() != candidate.from.y) {
+            // Moved since the plan was made
+            auto next = botunit->getNextLocation(unitMapLocation, false);
+            candidate.from = Position(unitMapLocation.get_x(), unitMapLocation.get_y());
+            candidate.next = Position(next.get_x(), next.get_y());
+            candidate.score = botunit->pathfindingScore;
+        }
+        if (candidate.score <= -10000) continue;
+
+        MapLocation nextLocation(planet, candidate.next.x, candidate.next.y);
+        auto dir = unitMapLocation.direction_to(nextLocation);
+        if (nextLocation != unitMapLocation && gc.can_replicate(unitID, dir)) {
+            gc.replicate(unitID, dir);
+            onReplicate(unitID);
+            return true;
+        }
+
+        if (nextLocation != unitMapLocation && gc.get_karbonite() >= 60 && canSenseLocation.test(nextLocation.get_x(), nextLocation.get_y()) && gc.is_occupiable(nextLocation) && unitMapLocation.add(dir) == nextLocation && gc.get_unit(unitID).get_ability_heat() < 10) {
+            devsFixedReplicationBug = true;
+        }
+        // Replicate in the direction with the most karbonite.
+        // The candidates are sorted by score and the karbonite only breaks ties, so the first worker that can replicate is the best one.
+        double bestScore = -1;
+        Direction bestDirection = North;
+        for (int d = 0; d < 8; d++) {
+            if (gc.can_replicate(unitID, (Direction)d)) {
+                auto location = unitMapLocation.add((Direction)d);
+                double score = karboniteMap.weights[location.get_x()][location.get_y()];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestDirection = (Direction)d;
+                }
+            }
+        }
+        if (bestScore >= 0) {
+            gc.replicate(unitID, bestDirection);
+            onReplicate(unitID);
+            return true;
+        }
+    }
+    return false;
+}
+
 void addWorkerActions () {
     for (int replicateCount = 1; replicateCount <= 7; replicateCount++) {
         int workerCount = state.typeCount[Worker] + replicateCount;
@@ -686,49 +1070,7 @@ void addWorkerActions () {
         }
 
         macroObjects.emplace_back(replicateScore, unit_type_get_replicate_cost(), 2, [=]{
-            // Find best worker to replicate
-            double bestScore = -10000;
-            int bestID = -1;
-            Direction bestDirection = North;
-
-            for (auto& u : ourUnits) {
-                if(u.get_unit_type() == Worker && u.get_location().is_on_map() && u.get_ability_heat() < 10) {
-                    BotWorker* botunit = (BotWorker*)unitMap[u.get_id()];
-                    if (botunit != nullptr) {
-                        auto unitID = u.get_id();
-                        auto unitMapLocation = u.get_map_location();
-                        auto nextLocation = botunit->getNextLocation(unitMapLocation, false);
-                        auto dir = unitMapLocation.direction_to(nextLocation);
-                        double score = botunit->pathfindingScore;
-                        if (score > bestScore) {
-                            if (nextLocation != unitMapLocation && gc.can_replicate(unitID, dir)) {
-                                bestScore = score;
-                                bestID = unitID;
-                                bestDirection = dir;
-                            } else {
-                                if (nextLocation != unitMapLocation && gc.get_karbonite() >= 60 && gc.can_sense_location(nextLocation) && gc.is_occupiable(nextLocation) && unitMapLocation.add(dir) == nextLocation && gc.get_unit(unitID).get_ability_heat() < 10) {
-                                    devsFixedReplicationBug = true;
-                                }
-                                // Replicate in the direction with the most karbonite
-                                for (int d = 0; d < 8; d++) {
-                                    if (gc.can_replicate(unitID, (Direction)d)) {
-                                        nextLocation = unitMapLocation.add((Direction)d);
-                                        double score2 = score + 0.00001*karboniteMap.weights[nextLocation.get_x()][nextLocation.get_y()];
-                                        if (score2 > bestScore) {
-                                            bestScore = score2;
-                                            bestID = unitID;
-                                            bestDirection = (Direction)d;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (bestID != -1) {
-                gc.replicate(bestID, bestDirection);
+            if (replicationPlanner.replicateBest()) {
                 state.typeCount[Worker]++;
             }
         });
@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "bot_unit.h"
+#include "parallel.h"
 
 struct BotWorker : BotUnit {
 	int rocketDelay = 0;
@@ -15,5 +16,15 @@ struct BotWorker : BotUnit {
     void tick();
 };
 
+// Background job that computes the time maps matchWorkers will need for tiles around our workers.
+// Returns an empty job if there is nothing to compute.
+std::function<void()> speculateWorkerTimeMaps(const BackgroundTask& task);
+extern int speculativeTimeMapHits;
+
 void matchWorkers();
+// Targets the matching considers for every worker (and workers for every target) at full quality.
+// Lower is faster but may miss the best matching, 0 or less considers every pair.
+extern int workerMatchingCandidates;
+// Augmenting paths the worker matching needed this turn, low when few workers or targets changed
+extern int matchingAugmentations;
 void addWorkerActions();
\ No newline at end of file